@@ -0,0 +1,766 @@
+#ifndef INCLUDE_INJA_AOT_HPP_
+#define INCLUDE_INJA_AOT_HPP_
+
+#include <algorithm>
+#include <cctype>
+#include <cmath>
+#include <initializer_list>
+#include <map>
+#include <numeric>
+#include <ostream>
+#include <sstream>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <nlohmann/json.hpp>
+
+#include "config.hpp"
+#include "exceptions.hpp"
+#include "function_storage.hpp"
+#include "node.hpp"
+#include "template.hpp"
+#include "thread_pool.hpp"
+#include "utils.hpp"
+
+
+namespace inja {
+
+/*!
+ * \brief Runtime support for templates compiled into C++ by CppCompiler.
+ *
+ * The functions follow the semantics of the Renderer, so a compiled template prints the same as the interpreted one.
+ */
+namespace aot {
+
+using CompiledTemplate = void (*)(std::ostream &os, const json &data, const FunctionStorage &functions);
+
+[[noreturn]] inline void fail(const std::string &message, size_t line, size_t column) {
+  INJA_THROW(RenderError(message, SourceLocation {line, column}));
+}
+
+inline bool truthy(const json &value) {
+  if (value.is_boolean()) {
+    return value.get<bool>();
+  } else if (value.is_number()) {
+    return (value != 0);
+  } else if (value.is_null()) {
+    return false;
+  }
+  return !value.empty();
+}
+
+inline void print(std::ostream &os, const json &value) {
+  if (value.is_string()) {
+    os << value.get_ref<const json::string_t&>();
+  } else if (value.is_number_unsigned()) {
+    os << value.get<const json::number_unsigned_t>();
+  } else if (value.is_number_integer()) {
+    os << value.get<const json::number_integer_t>();
+  } else if (!value.is_null()) {
+    os << value.dump();
+  }
+}
+
+// Follows the keys of a variable, indexing arrays with numeric keys
+inline const json *find(const json *data, std::initializer_list<const char *> keys) {
+  for (auto key = keys.begin(); data && key != keys.end(); ++key) {
+    const nonstd::string_view name {*key};
+    if (data->is_object()) {
+      const auto it = data->find(*key);
+      data = (it != data->end()) ? &*it : nullptr;
+    } else if (data->is_array() && !name.empty() && std::all_of(name.begin(), name.end(), ::isdigit)) {
+      const size_t index = std::stoul(*key);
+      data = (index < data->size()) ? &(*data)[index] : nullptr;
+    } else {
+      data = nullptr;
+    }
+  }
+  return data;
+}
+
+// Variables that are not loop variables are looked up in the set variables first, then in the input
+inline const json *lookup(const json &locals, const json &data, std::initializer_list<const char *> keys) {
+  const json *value = find(&locals, keys);
+  return value ? value : find(&data, keys);
+}
+
+inline const json &need(const json *value, const char *name, size_t line, size_t column) {
+  if (!value) {
+    fail("variable '" + std::string(name) + "' not found", line, column);
+  }
+  return *value;
+}
+
+inline const json &value_or(const json *value, const json &fallback) {
+  return value ? *value : fallback;
+}
+
+inline json value_or_call(const json *value, const CallbackFunction &callback) {
+  if (value) {
+    return *value;
+  }
+  Arguments args {};
+  return callback(args);
+}
+
+template<typename... T>
+json call(const CallbackFunction &callback, const T&... values) {
+  Arguments args {&values...};
+  return callback(args);
+}
+
+inline json add(const json &a, const json &b) {
+  if (a.is_string() && b.is_string()) {
+    return a.get_ref<const std::string&>() + b.get_ref<const std::string&>();
+  } else if (a.is_number_integer() && b.is_number_integer()) {
+    return a.get<int>() + b.get<int>();
+  }
+  return a.get<double>() + b.get<double>();
+}
+
+inline json subtract(const json &a, const json &b) {
+  if (a.is_number_integer() && b.is_number_integer()) {
+    return a.get<int>() - b.get<int>();
+  }
+  return a.get<double>() - b.get<double>();
+}
+
+inline json multiply(const json &a, const json &b) {
+  if (a.is_number_integer() && b.is_number_integer()) {
+    return a.get<int>() * b.get<int>();
+  }
+  return a.get<double>() * b.get<double>();
+}
+
+inline json divide(const json &a, const json &b, size_t line, size_t column) {
+  if (b.get<double>() == 0) {
+    fail("division by zero", line, column);
+  }
+  return a.get<double>() / b.get<double>();
+}
+
+inline json power(const json &a, const json &b) {
+  if (a.is_number_integer() && b.get<int>() >= 0) {
+    return static_cast<int>(std::pow(a.get<int>(), b.get<int>()));
+  }
+  return std::pow(a.get<double>(), b.get<int>());
+}
+
+inline json contains(const json &container, const json &value) {
+  return std::find(container.begin(), container.end(), value) != container.end();
+}
+
+inline const json &at(const json &container, const json &index) {
+  if (container.is_object()) {
+    return container.at(index.get<std::string>());
+  }
+  return container.at(index.get<int>());
+}
+
+inline json exists(const json &data, const json &name) {
+  return data.contains(json::json_pointer(JsonNode::convert_dot_to_json_ptr(name.get_ref<const std::string &>())));
+}
+
+inline json exists_in(const json &object, const json &name) {
+  return object.find(name.get_ref<const std::string &>()) != object.end();
+}
+
+inline json divisible_by(const json &a, const json &b) {
+  const int divisor = b.get<int>();
+  return (divisor != 0) && (a.get<int>() % divisor == 0);
+}
+
+inline json length(const json &value) {
+  if (value.is_string()) {
+    return value.get_ref<const std::string &>().length();
+  }
+  return value.size();
+}
+
+inline json lower(const json &value) {
+  std::string result = value.get<std::string>();
+  std::transform(result.begin(), result.end(), result.begin(), ::tolower);
+  return result;
+}
+
+inline json upper(const json &value) {
+  std::string result = value.get<std::string>();
+  std::transform(result.begin(), result.end(), result.begin(), ::toupper);
+  return result;
+}
+
+inline const json &max(const json &value) {
+  return *std::max_element(value.begin(), value.end());
+}
+
+inline const json &min(const json &value) {
+  return *std::min_element(value.begin(), value.end());
+}
+
+inline json range(const json &value) {
+  std::vector<int> result(value.get<int>());
+  std::iota(result.begin(), result.end(), 0);
+  return result;
+}
+
+inline json round(const json &value, const json &digits) {
+  const int precision = digits.get<int>();
+  const double result = std::round(value.get<double>() * std::pow(10.0, precision)) / std::pow(10.0, precision);
+  if (precision == 0) {
+    return int(result);
+  }
+  return result;
+}
+
+inline json sort(const json &value) {
+  json result = value.get<std::vector<json>>();
+  std::sort(result.begin(), result.end());
+  return result;
+}
+
+inline json join(const json &values, const json &separator) {
+  std::ostringstream os;
+  std::string sep;
+  for (const auto &value : values) {
+    os << sep;
+    if (value.is_string()) {
+      os << value.get<std::string>();
+    } else {
+      os << value;
+    }
+    sep = separator.get<std::string>();
+  }
+  return os.str();
+}
+
+// Renders the items of a parallel loop on the shared ThreadPool, with nullptr keys for arrays
+template<typename Body>
+void parallel_for(std::ostream &os, const json &container, const Body &body) {
+  const auto render = [&](std::ostream &out, size_t first, size_t last) {
+    json key;
+    auto it = std::next(container.begin(), first);
+    for (size_t index = first; index < last; ++index, ++it) {
+      if (container.is_object()) {
+        key = it.key();
+      }
+      body(out, key, it.value(), index);
+    }
+  };
+  if (!ThreadPool::shared().render_in_order(os, container.size(), render)) {
+    render(os, 0, container.size());
+  }
+}
+
+} // namespace aot
+
+/*!
+ * \brief Class for translating a Template into the source of a C++ function that renders it.
+ *
+ * The function writes text with straight-line appends and evaluates expressions with the helpers in inja::aot. Loop
+ * variables and loop.* are resolved at translation time, included templates are inlined and callbacks are looked up
+ * once per render. Templates using extends, block or super() cannot be translated.
+ */
+class CppCompiler : public NodeVisitor {
+  using Op = FunctionStorage::Operation;
+
+  // A translated expression, and whether it refers to a value that outlives the statement
+  struct Expression {
+    std::string code;
+    bool lvalue;
+  };
+
+  struct Loop {
+    const ForStatementNode *node;
+    size_t id;
+  };
+
+  const RenderConfig config;
+  const TemplateStorage &template_storage;
+  const FunctionStorage &function_storage;
+
+  const std::string *content;
+  std::vector<std::string> include_stack;
+
+  std::ostringstream body;
+  std::string indent;
+  std::string text;
+  Expression result;
+
+  std::vector<Loop> loops;
+  size_t next_id {0};
+  std::string locals;
+
+  std::map<std::pair<std::string, int>, std::string> callbacks;
+  std::ostringstream declarations;
+
+  static std::string quote(nonstd::string_view value) {
+    std::string result = "\"";
+    for (const char c : value) {
+      switch (c) {
+      case '"': result += "\\\""; break;
+      case '\\': result += "\\\\"; break;
+      case '\n': result += "\\n"; break;
+      case '\t': result += "\\t"; break;
+      default: {
+        if (static_cast<unsigned char>(c) < 0x20 || c == 0x7f) {
+          const char octal[] = {'\\', static_cast<char>('0' + ((c >> 6) & 3)), static_cast<char>('0' + ((c >> 3) & 7)), static_cast<char>('0' + (c & 7)), 0};
+          result += octal;
+        } else {
+          result += c;
+        }
+      }
+      }
+    }
+    return result + "\"";
+  }
+
+  SourceLocation location(const AstNode &node) const {
+    return get_source_location(*content, node.pos);
+  }
+
+  std::string location_arguments(const AstNode &node) const {
+    const SourceLocation loc = location(node);
+    return std::to_string(loc.line) + ", " + std::to_string(loc.column);
+  }
+
+  void throw_compiler_error(const std::string &message, const AstNode &node) const {
+    INJA_THROW(ParserError(message + " cannot be compiled to C++", location(node)));
+  }
+
+  void flush_text() {
+    if (!text.empty()) {
+      body << indent << "os.write(" << quote(text) << ", " << text.size() << ");\n";
+      text.clear();
+    }
+  }
+
+  void line(const std::string &code) {
+    flush_text();
+    body << indent << code << "\n";
+  }
+
+  void open(const std::string &code = "") {
+    line(code.empty() ? "{" : code + " {");
+    indent += "  ";
+  }
+
+  void close(const std::string &code = "}") {
+    flush_text();
+    indent.resize(indent.size() - 2);
+    body << indent << code << "\n";
+  }
+
+  Expression translate(const AstNode &node) {
+    node.accept(*this);
+    return result;
+  }
+
+  std::string callback(const std::string &name, int number_args) {
+    const auto key = std::make_pair(name, number_args);
+    auto it = callbacks.find(key);
+    if (it == callbacks.end()) {
+      const std::string id = "callback" + std::to_string(callbacks.size());
+      declarations << "  const inja::CallbackFunction &" << id << " = functions.find_function(" << quote(name) << ", " << number_args << ").callback;\n";
+      it = callbacks.emplace(key, id).first;
+    }
+    return it->second;
+  }
+
+  static std::string key_list(const JsonNode &node, size_t first) {
+    std::string result = "{";
+    for (size_t i = first; i < node.keys.size(); ++i) {
+      result += (i > first ? ", " : "") + quote(node.keys[i]);
+    }
+    return result + "}";
+  }
+
+  // loop.index and friends of the given loop, or of its parents
+  Expression loop_data(const JsonNode &node) {
+    size_t depth = loops.size();
+    size_t key = 1;
+    while (key < node.keys.size() && node.keys[key] == "parent" && depth > 0) {
+      depth -= 1;
+      key += 1;
+    }
+    if (depth == 0 || key + 1 != node.keys.size()) {
+      throw_compiler_error("'" + node.name + "'", node);
+    }
+
+    const std::string id = std::to_string(loops[depth - 1].id);
+    const std::string &name = node.keys[key];
+    if (name == "index") {
+      return {"inja::json(index" + id + ")", false};
+    } else if (name == "index1") {
+      return {"inja::json(index" + id + " + 1)", false};
+    } else if (name == "is_first") {
+      return {"inja::json(index" + id + " == 0)", false};
+    } else if (name == "is_last") {
+      return {"inja::json(index" + id + " + 1 == size" + id + ")", false};
+    }
+    throw_compiler_error("'" + node.name + "'", node);
+    return {};
+  }
+
+  // The C++ pointer to a variable, which is nullptr if it is not found, or an empty string for loop.* data
+  std::string find_variable(const JsonNode &node, bool &is_loop_data) {
+    is_loop_data = false;
+    for (auto loop = loops.rbegin(); loop != loops.rend(); ++loop) {
+      const std::string id = std::to_string(loop->id);
+      const auto object_loop = dynamic_cast<const ForObjectStatementNode *>(loop->node);
+      std::string variable;
+      if (object_loop && object_loop->key == node.keys.front()) {
+        variable = "key" + id;
+      } else if (object_loop ? object_loop->value == node.keys.front() : static_cast<const ForArrayStatementNode *>(loop->node)->value == node.keys.front()) {
+        variable = "value" + id;
+      } else {
+        continue;
+      }
+      return (node.keys.size() == 1) ? "&" + variable : "inja::aot::find(&" + variable + ", " + key_list(node, 1) + ")";
+    }
+
+    if (!loops.empty() && node.keys.front() == "loop") {
+      is_loop_data = true;
+      return "";
+    }
+    return "inja::aot::lookup(" + locals + ", data, " + key_list(node, 0) + ")";
+  }
+
+  void visit(const BlockNode &node) {
+    for (auto &n : node.nodes) {
+      n->accept(*this);
+    }
+  }
+
+  void visit(const TextNode &node) {
+    text.append(*content, node.pos, node.length);
+  }
+
+  void visit(const ExpressionNode &) { }
+
+  void visit(const LiteralNode &node) {
+    const std::string id = "literal" + std::to_string(next_id++);
+    declarations << "  static const inja::json " << id << " = inja::json::parse(" << quote(node.value.dump()) << ");\n";
+    result = {id, true};
+  }
+
+  void visit(const JsonNode &node) {
+    bool is_loop_data;
+    const std::string pointer = find_variable(node, is_loop_data);
+    if (is_loop_data) {
+      result = loop_data(node);
+    } else if (pointer.front() == '&') {
+      result = {pointer.substr(1), true};
+    } else if (function_storage.find_function(node.name, 0).operation == Op::Callback) {
+      result = {"inja::aot::value_or_call(" + pointer + ", " + callback(node.name, 0) + ")", false};
+    } else {
+      result = {"inja::aot::need(" + pointer + ", " + quote(node.name) + ", " + location_arguments(node) + ")", true};
+    }
+  }
+
+  void visit(const FunctionNode &node) {
+    std::vector<Expression> args;
+    if (node.operation != Op::Default) {
+      for (const auto &argument : node.arguments) {
+        if (node.operation == Op::AtId && &argument == &node.arguments.back()) {
+          break;
+        }
+        args.push_back(translate(*argument));
+      }
+    }
+    const auto arg = [&](size_t i) {
+      if (i >= args.size()) {
+        throw_compiler_error("function with missing arguments", node);
+      }
+      return args[i].code;
+    };
+    const auto value = [](const std::string &code) { return Expression {code, false}; };
+    const auto wrap = [](const std::string &code) { return Expression {"inja::json(" + code + ")", false}; };
+
+    switch (node.operation) {
+    case Op::Not: result = wrap("!inja::aot::truthy(" + arg(0) + ")"); break;
+    case Op::And: result = wrap("inja::aot::truthy(" + arg(0) + ") && inja::aot::truthy(" + arg(1) + ")"); break;
+    case Op::Or: result = wrap("inja::aot::truthy(" + arg(0) + ") || inja::aot::truthy(" + arg(1) + ")"); break;
+    case Op::In: result = value("inja::aot::contains(" + arg(1) + ", " + arg(0) + ")"); break;
+    case Op::Equal: result = wrap(arg(0) + " == " + arg(1)); break;
+    case Op::NotEqual: result = wrap(arg(0) + " != " + arg(1)); break;
+    case Op::Greater: result = wrap(arg(0) + " > " + arg(1)); break;
+    case Op::GreaterEqual: result = wrap(arg(0) + " >= " + arg(1)); break;
+    case Op::Less: result = wrap(arg(0) + " < " + arg(1)); break;
+    case Op::LessEqual: result = wrap(arg(0) + " <= " + arg(1)); break;
+    case Op::Add: result = value("inja::aot::add(" + arg(0) + ", " + arg(1) + ")"); break;
+    case Op::Subtract: result = value("inja::aot::subtract(" + arg(0) + ", " + arg(1) + ")"); break;
+    case Op::Multiplication: result = value("inja::aot::multiply(" + arg(0) + ", " + arg(1) + ")"); break;
+    case Op::Division: result = value("inja::aot::divide(" + arg(0) + ", " + arg(1) + ", " + location_arguments(node) + ")"); break;
+    case Op::Power: result = value("inja::aot::power(" + arg(0) + ", " + arg(1) + ")"); break;
+    case Op::Modulo: result = wrap(arg(0) + ".get<int>() % " + arg(1) + ".get<int>()"); break;
+    case Op::AtId: {
+      const auto id_node = dynamic_cast<const JsonNode *>(node.arguments.back().get());
+      if (!id_node) {
+        throw_compiler_error("member access by expression", node);
+      }
+      result = {arg(0) + ".at(" + quote(id_node->name) + ")", args[0].lvalue};
+    } break;
+    case Op::At: result = {"inja::aot::at(" + arg(0) + ", " + arg(1) + ")", args[0].lvalue}; break;
+    case Op::Default: {
+      if (node.arguments.size() < 2) {
+        throw_compiler_error("function with missing arguments", node);
+      }
+      const Expression fallback = translate(*node.arguments[1]);
+      const auto test_node = dynamic_cast<const JsonNode *>(node.arguments[0].get());
+      bool is_loop_data = false;
+      const std::string pointer = test_node ? find_variable(*test_node, is_loop_data) : "";
+      if (!test_node || is_loop_data || function_storage.find_function(test_node->name, 0).operation == Op::Callback) {
+        result = translate(*node.arguments[0]);
+      } else {
+        result = {"inja::aot::value_or(" + pointer + ", " + fallback.code + ")", fallback.lvalue};
+      }
+    } break;
+    case Op::DivisibleBy: result = value("inja::aot::divisible_by(" + arg(0) + ", " + arg(1) + ")"); break;
+    case Op::Even: result = wrap(arg(0) + ".get<int>() % 2 == 0"); break;
+    case Op::Odd: result = wrap(arg(0) + ".get<int>() % 2 != 0"); break;
+    case Op::Exists: result = value("inja::aot::exists(data, " + arg(0) + ")"); break;
+    case Op::ExistsInObject: result = value("inja::aot::exists_in(" + arg(0) + ", " + arg(1) + ")"); break;
+    case Op::First: result = {arg(0) + ".front()", args[0].lvalue}; break;
+    case Op::Last: result = {arg(0) + ".back()", args[0].lvalue}; break;
+    case Op::Float: result = wrap("std::stod(" + arg(0) + ".get_ref<const std::string &>())"); break;
+    case Op::Int: result = wrap("std::stoi(" + arg(0) + ".get_ref<const std::string &>())"); break;
+    case Op::Length: result = value("inja::aot::length(" + arg(0) + ")"); break;
+    case Op::Lower: result = value("inja::aot::lower(" + arg(0) + ")"); break;
+    case Op::Upper: result = value("inja::aot::upper(" + arg(0) + ")"); break;
+    case Op::Max: result = {"inja::aot::max(" + arg(0) + ")", args[0].lvalue}; break;
+    case Op::Min: result = {"inja::aot::min(" + arg(0) + ")", args[0].lvalue}; break;
+    case Op::Range: result = value("inja::aot::range(" + arg(0) + ")"); break;
+    case Op::Round: result = value("inja::aot::round(" + arg(0) + ", " + arg(1) + ")"); break;
+    case Op::Sort: result = value("inja::aot::sort(" + arg(0) + ")"); break;
+    case Op::IsBoolean: result = wrap(arg(0) + ".is_boolean()"); break;
+    case Op::IsNumber: result = wrap(arg(0) + ".is_number()"); break;
+    case Op::IsInteger: result = wrap(arg(0) + ".is_number_integer()"); break;
+    case Op::IsFloat: result = wrap(arg(0) + ".is_number_float()"); break;
+    case Op::IsObject: result = wrap(arg(0) + ".is_object()"); break;
+    case Op::IsArray: result = wrap(arg(0) + ".is_array()"); break;
+    case Op::IsString: result = wrap(arg(0) + ".is_string()"); break;
+    case Op::Join: result = value("inja::aot::join(" + arg(0) + ", " + arg(1) + ")"); break;
+    case Op::Callback: {
+      std::string code = "inja::aot::call(" + callback(node.name, node.number_args);
+      for (const auto &a : args) {
+        code += ", " + a.code;
+      }
+      result = value(code + ")");
+    } break;
+    case Op::Super:
+    case Op::ParenLeft:
+    case Op::ParenRight:
+    case Op::None: {
+      throw_compiler_error("function", node);
+    } break;
+    }
+  }
+
+  void visit(const ExpressionListNode &node) {
+    if (!node.root) {
+      throw_compiler_error("empty expression", node);
+    }
+
+    const auto literal = dynamic_cast<const LiteralNode *>(node.root.get());
+    if (literal) {
+      std::ostringstream os;
+      aot::print(os, literal->value);
+      text += os.str();
+      return;
+    }
+    line("inja::aot::print(os, " + translate(*node.root).code + ");");
+  }
+
+  void visit(const StatementNode &) { }
+
+  void visit(const ForStatementNode &) { }
+
+  // Containers that are computed by the loop condition are kept alive for the whole loop, and copied if the body sets
+  // variables that could replace them
+  void begin_loop(const ForStatementNode &node, const char *type, const char *check) {
+    if (!node.condition.root) {
+      throw_compiler_error("empty expression", node);
+    }
+    const size_t loop_id = next_id++;
+    const std::string id = std::to_string(loop_id);
+    const Expression container = translate(*node.condition.root);
+    const bool reference = container.lvalue && !sets_variables(node.body);
+
+    open();
+    line(std::string(reference ? "const inja::json &" : "const inja::json ") + "container" + id + " = " + container.code + ";");
+    open("if (!container" + id + "." + check + "())");
+    line("inja::aot::fail(\"object must be an " + std::string(type) + "\", " + location_arguments(node) + ");");
+    close();
+    line("[[maybe_unused]] const size_t size" + id + " = container" + id + ".size();");
+    if (!node.parallel) {
+      line("size_t index" + id + " = 0;");
+    }
+    loops.push_back({&node, loop_id});
+  }
+
+  void end_loop(const ForStatementNode &node) {
+    node.body.accept(*this);
+    line("++index" + std::to_string(loops.back().id) + ";");
+    close();
+    close();
+    loops.pop_back();
+  }
+
+  // The body becomes a lambda taking the stream and loop variables of one item
+  void parallel_loop(const ForStatementNode &node, const char *type, const char *check) {
+    begin_loop(node, type, check);
+    const std::string id = std::to_string(loops.back().id);
+    open("inja::aot::parallel_for(os, container" + id + ", [&](std::ostream &os, [[maybe_unused]] const inja::json &key" + id +
+         ", const inja::json &value" + id + ", [[maybe_unused]] size_t index" + id + ")");
+    node.body.accept(*this);
+    close("});");
+    close();
+    loops.pop_back();
+  }
+
+  void visit(const ForArrayStatementNode &node) {
+    if (node.parallel) {
+      parallel_loop(node, "array", "is_array");
+      return;
+    }
+    begin_loop(node, "array", "is_array");
+    const std::string id = std::to_string(loops.back().id);
+    open("for (const inja::json &value" + id + " : container" + id + ")");
+    end_loop(node);
+  }
+
+  void visit(const ForObjectStatementNode &node) {
+    if (node.parallel) {
+      parallel_loop(node, "object", "is_object");
+      return;
+    }
+    begin_loop(node, "object", "is_object");
+    const std::string id = std::to_string(loops.back().id);
+    open("for (auto it" + id + " = container" + id + ".begin(); it" + id + " != container" + id + ".end(); ++it" + id + ")");
+    line("const inja::json key" + id + " = it" + id + ".key();");
+    line("const inja::json &value" + id + " = it" + id + ".value();");
+    end_loop(node);
+  }
+
+  void visit(const IfStatementNode &node) {
+    if (!node.condition.root) {
+      throw_compiler_error("empty expression", node);
+    }
+    open("if (inja::aot::truthy(" + translate(*node.condition.root).code + "))");
+    node.true_statement.accept(*this);
+    if (node.has_false_statement) {
+      close("} else {");
+      indent += "  ";
+      node.false_statement.accept(*this);
+    }
+    close();
+  }
+
+  // Whether a template sets variables, which an included template must not leak to the one including it
+  static bool sets_variables(const BlockNode &block) {
+    for (const auto &n : block.nodes) {
+      if (dynamic_cast<const SetStatementNode *>(n.get())) {
+        return true;
+      } else if (const auto loop = dynamic_cast<const ForStatementNode *>(n.get())) {
+        if (sets_variables(loop->body)) {
+          return true;
+        }
+      } else if (const auto condition = dynamic_cast<const IfStatementNode *>(n.get())) {
+        if (sets_variables(condition->true_statement) || sets_variables(condition->false_statement)) {
+          return true;
+        }
+      }
+    }
+    return false;
+  }
+
+  void visit(const IncludeStatementNode &node) {
+    const Template *included_template = find_template(template_storage, node.file, node.resolved.get());
+    if (!included_template) {
+      if (config.throw_at_missing_includes) {
+        line("inja::aot::fail(" + quote("include '" + node.file + "' not found") + ", " + location_arguments(node) + ");");
+      }
+      return;
+    }
+    if (std::find(include_stack.begin(), include_stack.end(), node.file) != include_stack.end()) {
+      throw_compiler_error("recursive include of '" + node.file + "'", node);
+    }
+
+    const Template &included = *included_template;
+    const std::string *old_content = content;
+    const std::string old_locals = locals;
+
+    include_stack.push_back(node.file);
+    open();
+    if (sets_variables(included.root)) {
+      locals = "locals" + std::to_string(next_id++);
+      line("inja::json " + locals + " = " + old_locals + ";");
+    }
+    content = &included.content;
+    included.root.accept(*this);
+    content = old_content;
+    close();
+    include_stack.pop_back();
+    locals = old_locals;
+  }
+
+  void visit(const ExtendsStatementNode &node) {
+    throw_compiler_error("extends", node);
+  }
+
+  void visit(const BlockStatementNode &node) {
+    throw_compiler_error("block", node);
+  }
+
+  void visit(const SetStatementNode &node) {
+    if (!node.expression.root) {
+      throw_compiler_error("empty expression", node);
+    }
+    // As in the renderer, an included template must not set a loop variable of the one including it
+    const std::string root_key = node.key.substr(0, node.key.find('.'));
+    for (const auto &loop : loops) {
+      const auto object_loop = dynamic_cast<const ForObjectStatementNode *>(loop.node);
+      const std::string &value = object_loop ? object_loop->value : static_cast<const ForArrayStatementNode *>(loop.node)->value;
+      if (root_key == value || (object_loop && root_key == object_loop->key)) {
+        line("inja::aot::fail(" + quote("cannot set loop variable '" + root_key + "'") + ", " + location_arguments(node) + ");");
+        return;
+      }
+    }
+    std::string ptr = node.key;
+    replace_substring(ptr, ".", "/");
+    line(locals + "[inja::json::json_pointer(" + quote("/" + ptr) + ")] = " + translate(*node.expression.root).code + ";");
+  }
+
+public:
+  CppCompiler(const RenderConfig &config, const TemplateStorage &template_storage, const FunctionStorage &function_storage)
+      : config(config), template_storage(template_storage), function_storage(function_storage) { }
+
+  /// Returns the definition of an inline function with the signature of aot::CompiledTemplate
+  std::string compile(const Template &tmpl, const std::string &function_name) {
+    content = &tmpl.content;
+    include_stack.clear();
+    body.str("");
+    declarations.str("");
+    callbacks.clear();
+    indent = "  ";
+    text.clear();
+    next_id = 0;
+    locals = "locals";
+
+    tmpl.root.accept(*this);
+    flush_text();
+
+    std::ostringstream os;
+    os << "inline void " << function_name << "(std::ostream &os, [[maybe_unused]] const inja::json &data, [[maybe_unused]] const inja::FunctionStorage &functions) {\n";
+    os << declarations.str();
+    os << "  [[maybe_unused]] inja::json locals;\n";
+    os << body.str();
+    os << "}\n";
+    return os.str();
+  }
+};
+
+} // namespace inja
+
+#endif // INCLUDE_INJA_AOT_HPP_
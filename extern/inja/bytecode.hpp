@@ -0,0 +1,366 @@
+#ifndef INCLUDE_INJA_BYTECODE_HPP_
+#define INCLUDE_INJA_BYTECODE_HPP_
+
+#include <algorithm>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <nlohmann/json.hpp>
+
+#include "node.hpp"
+
+
+namespace inja {
+
+/*!
+ * \brief A single instruction of a compiled template.
+ *
+ * The operands are register indices, jump targets or offsets into the text pool, depending on the opcode.
+ */
+struct Instruction {
+  enum class Op : uint8_t {
+    Text,        // write b characters of the text pool from a
+    Print,       // print register a
+    Literal,     // a = value of the literal node
+    Load,        // a = value of the variable node; if b, a is nullptr when it is not found
+    Call,        // a = function node applied to the c registers from b
+    Member,      // a = element of register b named by the variable node
+    Truthy,      // a = truthy(b)
+    Not,         // a = !truthy(b)
+    Jump,        // continue at a
+    JumpIfFalse, // continue at b if register a is falsy
+    JumpIfTrue,  // continue at b if register a is truthy
+    JumpIfFound, // continue at b if register a is not nullptr
+    LoopBegin,   // iterate over register a (as key, value pairs if c), or continue at b if it is empty
+    LoopNext,    // continue at a while the innermost loop has items left
+    LoopParallel, // render the body up to b for each item of register a, see Renderer::render_loop
+    Include,     // render the included template
+    Set,         // store register a under the key of the set node
+    Mark,        // remember the temporaries in scope a
+    Release,     // drop the temporaries created since scope a was marked
+  };
+
+  Op op;
+  uint32_t a {0};
+  uint32_t b {0};
+  uint32_t c {0};
+  const AstNode *node {nullptr};
+};
+
+/*!
+ * \brief A template compiled into linear code, as run by the Renderer.
+ *
+ * Instructions point into the AST of the template they were compiled from, which has to outlive them.
+ */
+struct Bytecode {
+  std::vector<Instruction> instructions;
+  std::string text;
+
+  size_t registers {0};
+  size_t scopes {0};
+  size_t loops {0};
+};
+
+/*!
+ * \brief Class for compiling a Template into Bytecode.
+ *
+ * Adjacent text and printed literals are folded into single Text instructions, conditions and loops become jumps,
+ * and every expression is evaluated into a register. Templates using extends, block or super() are not compiled
+ * and are rendered from their AST instead.
+ */
+class BytecodeCompiler : public NodeVisitor {
+  using Op = FunctionStorage::Operation;
+  using Code = Instruction::Op;
+
+  std::shared_ptr<Bytecode> code;
+  const std::string *content;
+  bool supported {true};
+
+  uint32_t target {0};
+  uint32_t next_register {0};
+  uint32_t scope_depth {0};
+  uint32_t loop_depth {0};
+
+  // Whether the last instruction is a Text that the next text can be appended to
+  bool text_open {false};
+
+  size_t emit(Code op, uint32_t a = 0, uint32_t b = 0, uint32_t c = 0, const AstNode *node = nullptr) {
+    text_open = false;
+    code->instructions.push_back({op, a, b, c, node});
+    return code->instructions.size() - 1;
+  }
+
+  // Position of the next instruction as a jump target, which text from before it must not be merged across
+  uint32_t label() {
+    text_open = false;
+    return static_cast<uint32_t>(code->instructions.size());
+  }
+
+  void append_text(const char *data, size_t length) {
+    if (length == 0) {
+      return;
+    }
+    if (!text_open) {
+      emit(Code::Text, static_cast<uint32_t>(code->text.size()));
+      text_open = true;
+    }
+    code->text.append(data, length);
+    code->instructions.back().b += static_cast<uint32_t>(length);
+  }
+
+  uint32_t allocate(uint32_t count = 1) {
+    const uint32_t first = next_register;
+    next_register += count;
+    code->registers = std::max<size_t>(code->registers, next_register);
+    return first;
+  }
+
+  // Registers above the target are free again once the expression is evaluated
+  void compile_into(const AstNode &node, uint32_t reg) {
+    const uint32_t old_target = target;
+    const uint32_t old_next = next_register;
+    target = reg;
+    node.accept(*this);
+    target = old_target;
+    next_register = old_next;
+  }
+
+  uint32_t compile_expression_list(const ExpressionListNode &node) {
+    if (!node.root) {
+      supported = false;
+      return 0;
+    }
+    const uint32_t reg = allocate();
+    compile_into(*node.root, reg);
+    return reg;
+  }
+
+  uint32_t begin_scope() {
+    const uint32_t scope = scope_depth++;
+    code->scopes = std::max<size_t>(code->scopes, scope_depth);
+    emit(Code::Mark, scope);
+    return scope;
+  }
+
+  void end_scope(uint32_t scope) {
+    emit(Code::Release, scope);
+    scope_depth -= 1;
+  }
+
+  // Printed literals become text, formatted as the Renderer prints them
+  static std::string literal_text(const json &value) {
+    if (value.is_string()) {
+      return value.get<std::string>();
+    } else if (value.is_number_unsigned()) {
+      return std::to_string(value.get<json::number_unsigned_t>());
+    } else if (value.is_number_integer()) {
+      return std::to_string(value.get<json::number_integer_t>());
+    } else if (value.is_null()) {
+      return "";
+    }
+    return value.dump();
+  }
+
+  void visit(const BlockNode &node) {
+    for (auto &n : node.nodes) {
+      n->accept(*this);
+    }
+  }
+
+  void visit(const TextNode &node) {
+    append_text(content->data() + node.pos, node.length);
+  }
+
+  void visit(const ExpressionNode &) { }
+
+  void visit(const LiteralNode &node) {
+    emit(Code::Literal, target, 0, 0, &node);
+  }
+
+  void visit(const JsonNode &node) {
+    emit(Code::Load, target, 0, 0, &node);
+  }
+
+  void visit(const FunctionNode &node) {
+    switch (node.operation) {
+    case Op::Not: {
+      if (node.arguments.size() < 1) {
+        supported = false;
+        return;
+      }
+      const uint32_t arg = allocate();
+      compile_into(*node.arguments[0], arg);
+      emit(Code::Not, target, arg);
+    } break;
+    case Op::And:
+    case Op::Or: {
+      if (node.arguments.size() < 2) {
+        supported = false;
+        return;
+      }
+      compile_into(*node.arguments[0], target);
+      emit(Code::Truthy, target, target);
+      const size_t jump = emit((node.operation == Op::And) ? Code::JumpIfFalse : Code::JumpIfTrue, target);
+      compile_into(*node.arguments[1], target);
+      emit(Code::Truthy, target, target);
+      code->instructions[jump].b = label();
+    } break;
+    case Op::Default: {
+      if (node.arguments.size() < 2) {
+        supported = false;
+        return;
+      }
+      if (dynamic_cast<const JsonNode *>(node.arguments[0].get())) {
+        emit(Code::Load, target, 1, 0, node.arguments[0].get());
+      } else {
+        compile_into(*node.arguments[0], target);
+      }
+      const size_t jump = emit(Code::JumpIfFound, target);
+      compile_into(*node.arguments[1], target);
+      code->instructions[jump].b = label();
+    } break;
+    case Op::AtId: {
+      if (node.arguments.size() < 2 || !dynamic_cast<const JsonNode *>(node.arguments[1].get())) {
+        supported = false;
+        return;
+      }
+      const uint32_t container = allocate();
+      compile_into(*node.arguments[0], container);
+      emit(Code::Member, target, container, 0, node.arguments[1].get());
+    } break;
+    case Op::Super:
+    case Op::ParenLeft:
+    case Op::ParenRight:
+    case Op::None: {
+      supported = false;
+    } break;
+    default: {
+      const uint32_t count = static_cast<uint32_t>(node.arguments.size());
+      const uint32_t first = allocate(count);
+      for (uint32_t i = 0; i < count; ++i) {
+        compile_into(*node.arguments[i], first + i);
+      }
+      emit(Code::Call, target, first, count, &node);
+    } break;
+    }
+  }
+
+  void visit(const ExpressionListNode &node) {
+    const auto literal = dynamic_cast<const LiteralNode *>(node.root.get());
+    if (literal) {
+      const std::string text = literal_text(literal->value);
+      append_text(text.data(), text.size());
+      return;
+    }
+
+    const uint32_t scope = begin_scope();
+    emit(Code::Print, compile_expression_list(node));
+    end_scope(scope);
+    next_register = 0;
+  }
+
+  void visit(const StatementNode &) { }
+
+  void visit(const ForStatementNode &) { }
+
+  // The body of a parallel loop is run once per item, by whichever renderer renders that item
+  void compile_parallel_loop(const ForStatementNode &node, bool has_key) {
+    const uint32_t scope = begin_scope();
+    const size_t begin = emit(Code::LoopParallel, compile_expression_list(node.condition), 0, has_key, &node);
+    next_register = 0;
+
+    loop_depth += 1;
+    code->loops = std::max<size_t>(code->loops, loop_depth);
+    node.body.accept(*this);
+    loop_depth -= 1;
+
+    code->instructions[begin].b = label();
+    end_scope(scope);
+  }
+
+  void compile_loop(const ForStatementNode &node, bool has_key) {
+    if (node.parallel) {
+      compile_parallel_loop(node, has_key);
+      return;
+    }
+
+    const uint32_t scope = begin_scope();
+    const size_t begin = emit(Code::LoopBegin, compile_expression_list(node.condition), 0, has_key, &node);
+    next_register = 0;
+
+    loop_depth += 1;
+    code->loops = std::max<size_t>(code->loops, loop_depth);
+    const uint32_t body = label();
+    node.body.accept(*this);
+    emit(Code::LoopNext, body);
+    loop_depth -= 1;
+
+    code->instructions[begin].b = label();
+    end_scope(scope);
+  }
+
+  void visit(const ForArrayStatementNode &node) {
+    compile_loop(node, false);
+  }
+
+  void visit(const ForObjectStatementNode &node) {
+    compile_loop(node, true);
+  }
+
+  void visit(const IfStatementNode &node) {
+    const uint32_t scope = begin_scope();
+    const size_t jump_false = emit(Code::JumpIfFalse, compile_expression_list(node.condition));
+    next_register = 0;
+
+    node.true_statement.accept(*this);
+    if (node.has_false_statement) {
+      const size_t jump_end = emit(Code::Jump);
+      code->instructions[jump_false].b = label();
+      node.false_statement.accept(*this);
+      code->instructions[jump_end].a = label();
+    } else {
+      code->instructions[jump_false].b = label();
+    }
+    end_scope(scope);
+  }
+
+  void visit(const IncludeStatementNode &node) {
+    emit(Code::Include, 0, 0, 0, &node);
+  }
+
+  void visit(const ExtendsStatementNode &) {
+    supported = false;
+  }
+
+  void visit(const BlockStatementNode &) {
+    supported = false;
+  }
+
+  void visit(const SetStatementNode &node) {
+    const uint32_t scope = begin_scope();
+    emit(Code::Set, compile_expression_list(node.expression), 0, 0, &node);
+    end_scope(scope);
+    next_register = 0;
+  }
+
+public:
+  /// Returns nullptr if the template uses features that are only rendered from the AST
+  std::shared_ptr<const Bytecode> compile(const BlockNode &root, const std::string &template_content) {
+    code = std::make_shared<Bytecode>();
+    content = &template_content;
+    supported = true;
+    text_open = false;
+
+    root.accept(*this);
+    if (!supported) {
+      return nullptr;
+    }
+    return code;
+  }
+};
+
+} // namespace inja
+
+#endif // INCLUDE_INJA_BYTECODE_HPP_
@@ -65,13 +65,19 @@ struct LexerConfig {
  */
 struct ParserConfig {
   bool search_included_templates_in_files {true};
+  bool compile_bytecode {false};
 };
 
+class RenderProfiler;
+
 /*!
  * \brief Class for render configuration.
  */
 struct RenderConfig {
   bool throw_at_missing_includes {true};
+
+  //! Measures every statement and callback that is rendered, see RenderProfiler
+  RenderProfiler *profiler {nullptr};
 };
 
 } // namespace inja
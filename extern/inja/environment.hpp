@@ -9,6 +9,7 @@
 
 #include <nlohmann/json.hpp>
 
+#include "aot.hpp"
 #include "config.hpp"
 #include "function_storage.hpp"
 #include "parser.hpp"
@@ -92,11 +93,22 @@ public:
     parser_config.search_included_templates_in_files = search_in_files;
   }
 
+  /// Sets whether parsed templates are compiled to bytecode, which the renderer runs instead of walking the AST
+  void set_compile_bytecode(bool compile_bytecode) {
+    parser_config.compile_bytecode = compile_bytecode;
+  }
+
   /// Sets whether a missing include will throw an error
   void set_throw_at_missing_includes(bool will_throw) {
     render_config.throw_at_missing_includes = will_throw;
   }
 
+  /// Sets a profiler that renders with this environment add their measurements to, or nullptr to render without one.
+  /// Templates compiled to C++ are not profiled
+  void set_profiler(RenderProfiler *profiler) {
+    render_config.profiler = profiler;
+  }
+
   Template parse(nonstd::string_view input) {
     Parser parser(parser_config, lexer_config, template_storage, function_storage);
     return parser.parse(input);
@@ -158,6 +170,17 @@ public:
     return os;
   }
 
+  /// Renders a template that was compiled into C++ with compile_to_cpp, using the callbacks of this environment
+  std::ostream &render_to(std::ostream &os, aot::CompiledTemplate tmpl, const json &data) {
+    tmpl(os, data, function_storage);
+    return os;
+  }
+
+  /// Translates a template into the definition of a C++ function with the given name, see CppCompiler
+  std::string compile_to_cpp(const Template &tmpl, const std::string &function_name) {
+    return CppCompiler(render_config, template_storage, function_storage).compile(tmpl, function_name);
+  }
+
   std::string load_file(const std::string &filename) {
     Parser parser(parser_config, lexer_config, template_storage, function_storage);
     return parser.load_file(input_path + filename);
@@ -204,7 +227,14 @@ public:
    * include "<name>" syntax.
    */
   void include_template(const std::string &name, const Template &tmpl) {
-    template_storage[name] = tmpl;
+    template_storage[name] = std::make_shared<const Template>(tmpl);
+  }
+
+  /** Includes a template that is shared with other environments, without copying it.
+   * Templates already parsed keep the one they were parsed with.
+   */
+  void include_template(const std::string &name, std::shared_ptr<const Template> tmpl) {
+    template_storage[name] = std::move(tmpl);
   }
 };
 
@@ -1,6 +1,12 @@
 #ifndef INCLUDE_INJA_FUNCTION_STORAGE_HPP_
 #define INCLUDE_INJA_FUNCTION_STORAGE_HPP_
 
+#include <functional>
+#include <memory>
+#include <string>
+#include <tuple>
+#include <unordered_map>
+#include <utility>
 #include <vector>
 
 #include "string_view.hpp"
@@ -79,61 +85,90 @@ public:
 private:
   const int VARIADIC {-1};
 
-  std::map<std::pair<std::string, int>, FunctionData> function_storage = {
-    {std::make_pair("at", 2), FunctionData { Operation::At }},
-    {std::make_pair("default", 2), FunctionData { Operation::Default }},
-    {std::make_pair("divisibleBy", 2), FunctionData { Operation::DivisibleBy }},
-    {std::make_pair("even", 1), FunctionData { Operation::Even }},
-    {std::make_pair("exists", 1), FunctionData { Operation::Exists }},
-    {std::make_pair("existsIn", 2), FunctionData { Operation::ExistsInObject }},
-    {std::make_pair("first", 1), FunctionData { Operation::First }},
-    {std::make_pair("float", 1), FunctionData { Operation::Float }},
-    {std::make_pair("int", 1), FunctionData { Operation::Int }},
-    {std::make_pair("isArray", 1), FunctionData { Operation::IsArray }},
-    {std::make_pair("isBoolean", 1), FunctionData { Operation::IsBoolean }},
-    {std::make_pair("isFloat", 1), FunctionData { Operation::IsFloat }},
-    {std::make_pair("isInteger", 1), FunctionData { Operation::IsInteger }},
-    {std::make_pair("isNumber", 1), FunctionData { Operation::IsNumber }},
-    {std::make_pair("isObject", 1), FunctionData { Operation::IsObject }},
-    {std::make_pair("isString", 1), FunctionData { Operation::IsString }},
-    {std::make_pair("last", 1), FunctionData { Operation::Last }},
-    {std::make_pair("length", 1), FunctionData { Operation::Length }},
-    {std::make_pair("lower", 1), FunctionData { Operation::Lower }},
-    {std::make_pair("max", 1), FunctionData { Operation::Max }},
-    {std::make_pair("min", 1), FunctionData { Operation::Min }},
-    {std::make_pair("odd", 1), FunctionData { Operation::Odd }},
-    {std::make_pair("range", 1), FunctionData { Operation::Range }},
-    {std::make_pair("round", 2), FunctionData { Operation::Round }},
-    {std::make_pair("sort", 1), FunctionData { Operation::Sort }},
-    {std::make_pair("upper", 1), FunctionData { Operation::Upper }},
-    {std::make_pair("super", 0), FunctionData { Operation::Super }},
-    {std::make_pair("super", 1), FunctionData { Operation::Super }},
-    {std::make_pair("join", 2), FunctionData { Operation::Join }},
-  };
+  using Overloads = std::vector<std::pair<int, std::shared_ptr<const FunctionData>>>;
+
+  // Functions by name, each with one entry per number of arguments. Entries are never replaced, so call sites can
+  // keep the pointer they were bound to
+  std::unordered_map<std::string, Overloads> function_storage;
+
+  void add(nonstd::string_view name, int num_args, const FunctionData &data) {
+    auto &overloads = function_storage[static_cast<std::string>(name)];
+    for (const auto &overload : overloads) {
+      if (overload.first == num_args) {
+        return;
+      }
+    }
+    overloads.emplace_back(num_args, std::make_shared<const FunctionData>(data));
+  }
 
 public:
+  FunctionStorage() {
+    const std::tuple<const char *, int, Operation> builtins[] = {
+      {"at", 2, Operation::At},
+      {"default", 2, Operation::Default},
+      {"divisibleBy", 2, Operation::DivisibleBy},
+      {"even", 1, Operation::Even},
+      {"exists", 1, Operation::Exists},
+      {"existsIn", 2, Operation::ExistsInObject},
+      {"first", 1, Operation::First},
+      {"float", 1, Operation::Float},
+      {"int", 1, Operation::Int},
+      {"isArray", 1, Operation::IsArray},
+      {"isBoolean", 1, Operation::IsBoolean},
+      {"isFloat", 1, Operation::IsFloat},
+      {"isInteger", 1, Operation::IsInteger},
+      {"isNumber", 1, Operation::IsNumber},
+      {"isObject", 1, Operation::IsObject},
+      {"isString", 1, Operation::IsString},
+      {"last", 1, Operation::Last},
+      {"length", 1, Operation::Length},
+      {"lower", 1, Operation::Lower},
+      {"max", 1, Operation::Max},
+      {"min", 1, Operation::Min},
+      {"odd", 1, Operation::Odd},
+      {"range", 1, Operation::Range},
+      {"round", 2, Operation::Round},
+      {"sort", 1, Operation::Sort},
+      {"upper", 1, Operation::Upper},
+      {"super", 0, Operation::Super},
+      {"super", 1, Operation::Super},
+      {"join", 2, Operation::Join},
+    };
+    for (const auto &builtin : builtins) {
+      add_builtin(std::get<0>(builtin), std::get<1>(builtin), std::get<2>(builtin));
+    }
+  }
+
   void add_builtin(nonstd::string_view name, int num_args, Operation op) {
-    function_storage.emplace(std::make_pair(static_cast<std::string>(name), num_args), FunctionData { op });
+    add(name, num_args, FunctionData { op });
   }
 
   void add_callback(nonstd::string_view name, int num_args, const CallbackFunction &callback) {
-    function_storage.emplace(std::make_pair(static_cast<std::string>(name), num_args), FunctionData { Operation::Callback, callback });
+    add(name, num_args, FunctionData { Operation::Callback, callback });
   }
 
-  FunctionData find_function(nonstd::string_view name, int num_args) const {
-    auto it = function_storage.find(std::make_pair(static_cast<std::string>(name), num_args));
-    if (it != function_storage.end()) {
-      return it->second;
+  /// Returns the function a call site with the given name and number of arguments is bound to, or nullptr
+  std::shared_ptr<const FunctionData> bind(nonstd::string_view name, int num_args) const {
+    const auto it = function_storage.find(static_cast<std::string>(name));
+    if (it == function_storage.end()) {
+      return nullptr;
+    }
 
-    // Find variadic function
-    } else if (num_args > 0) {
-      it = function_storage.find(std::make_pair(static_cast<std::string>(name), VARIADIC));
-      if (it != function_storage.end()) {
-        return it->second;
+    std::shared_ptr<const FunctionData> variadic;
+    for (const auto &overload : it->second) {
+      if (overload.first == num_args) {
+        return overload.second;
+      } else if (overload.first == VARIADIC && num_args > 0) {
+        variadic = overload.second;
       }
     }
+    return variadic;
+  }
 
-    return FunctionData { Operation::None };
+  const FunctionData &find_function(nonstd::string_view name, int num_args) const {
+    static const FunctionData none { Operation::None };
+    const auto function = bind(name, num_args);
+    return function ? *function : none;
   }
 };
 
@@ -44,6 +44,7 @@ SOFTWARE.
 #include "environment.hpp"
 #include "exceptions.hpp"
 #include "parser.hpp"
+#include "profiler.hpp"
 #include "renderer.hpp"
 #include "string_view.hpp"
 #include "template.hpp"
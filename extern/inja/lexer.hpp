@@ -1,9 +1,15 @@
 #ifndef INCLUDE_INJA_LEXER_HPP_
 #define INCLUDE_INJA_LEXER_HPP_
 
+#include <array>
 #include <cctype>
+#include <cstring>
 #include <locale>
 
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
 #include "config.hpp"
 #include "token.hpp"
 #include "utils.hpp"
@@ -43,6 +49,43 @@ class Lexer {
   size_t tok_start;
   size_t pos;
 
+  // Bytes that can start an opening sequence
+  std::array<bool, 256> is_open_char {};
+
+  // Position of the first byte from the given one that can start an opening sequence, or npos. Text is scanned 16
+  // bytes at a time with SSE2, or with memchr if all openers start with the same byte
+  size_t find_open(size_t from) const {
+    const char *data = m_in.data();
+    const size_t size = m_in.size();
+    const std::string &open_chars = config.open_chars;
+
+    if (open_chars.size() == 1) {
+      const void *open = (from < size) ? std::memchr(data + from, open_chars[0], size - from) : nullptr;
+      return open ? static_cast<const char *>(open) - data : nonstd::string_view::npos;
+    }
+
+    size_t i = from;
+#if defined(__SSE2__)
+    for (; i + 16 <= size; i += 16) {
+      const __m128i chunk = _mm_loadu_si128(reinterpret_cast<const __m128i *>(data + i));
+      __m128i matches = _mm_setzero_si128();
+      for (const char ch : open_chars) {
+        matches = _mm_or_si128(matches, _mm_cmpeq_epi8(chunk, _mm_set1_epi8(ch)));
+      }
+      const int mask = _mm_movemask_epi8(matches);
+      if (mask != 0) {
+        return i + __builtin_ctz(static_cast<unsigned>(mask));
+      }
+    }
+#endif
+    for (; i < size; ++i) {
+      if (is_open_char[static_cast<unsigned char>(data[i])]) {
+        return i;
+      }
+    }
+    return nonstd::string_view::npos;
+  }
+
 
   Token scan_body(nonstd::string_view close, Token::Kind closeKind, nonstd::string_view close_trim = nonstd::string_view(), bool trim = false) {
   again:
@@ -270,7 +313,11 @@ class Lexer {
   }
 
 public:
-  explicit Lexer(const LexerConfig &config) : config(config), state(State::Text), minus_state(MinusState::Number) {}
+  explicit Lexer(const LexerConfig &config) : config(config), state(State::Text), minus_state(MinusState::Number) {
+    for (const char ch : config.open_chars) {
+      is_open_char[static_cast<unsigned char>(ch)] = true;
+    }
+  }
 
   SourceLocation current_position() const {
     return get_source_location(m_in, tok_start);
@@ -301,13 +348,13 @@ public:
     default:
     case State::Text: {
       // fast-scan to first open character
-      const size_t open_start = m_in.substr(pos).find_first_of(config.open_chars);
+      const size_t open_start = find_open(pos);
       if (open_start == nonstd::string_view::npos) {
         // didn't find open, return remaining text as text token
         pos = m_in.size();
         return make_token(Token::Kind::Text);
       }
-      pos += open_start;
+      pos = open_start;
 
       // try to match one of the opening sequences, and get the close
       nonstd::string_view open_str = m_in.substr(pos);
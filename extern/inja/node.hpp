@@ -1,6 +1,7 @@
 #ifndef INCLUDE_INJA_NODE_HPP_
 #define INCLUDE_INJA_NODE_HPP_
 
+#include <memory>
 #include <string>
 #include <utility>
 
@@ -8,6 +9,7 @@
 
 #include "function_storage.hpp"
 #include "string_view.hpp"
+#include "utils.hpp"
 
 
 namespace inja {
@@ -30,6 +32,7 @@ class ExtendsStatementNode;
 class BlockStatementNode;
 class SetStatementNode;
 
+struct Template;
 
 class NodeVisitor {
 public:
@@ -112,7 +115,13 @@ public:
 class JsonNode : public ExpressionNode {
 public:
   const std::string name;
-  const json::json_pointer ptr;
+  const std::vector<std::string> keys;
+
+  //! Index of the enclosing loop variable named by the first key, or -1 to look it up by name
+  int slot {-1};
+
+  //! Callback without arguments that is called if there is no variable of this name, if it was known when parsing
+  std::shared_ptr<const FunctionStorage::FunctionData> callback;
 
   static std::string convert_dot_to_json_ptr(nonstd::string_view ptr_name) {
     std::string result;
@@ -125,7 +134,17 @@ public:
     return result;
   }
 
-  explicit JsonNode(nonstd::string_view ptr_name, size_t pos) : ExpressionNode(pos), name(ptr_name), ptr(json::json_pointer(convert_dot_to_json_ptr(ptr_name))) { }
+  static std::vector<std::string> split_keys(nonstd::string_view ptr_name) {
+    std::vector<std::string> result;
+    do {
+      nonstd::string_view part;
+      std::tie(part, ptr_name) = string_view::split(ptr_name, '.');
+      result.emplace_back(part.begin(), part.end());
+    } while (!ptr_name.empty());
+    return result;
+  }
+
+  explicit JsonNode(nonstd::string_view ptr_name, size_t pos) : ExpressionNode(pos), name(ptr_name), keys(split_keys(ptr_name)) { }
 
   void accept(NodeVisitor& v) const {
     v.visit(*this);
@@ -149,7 +168,9 @@ public:
   std::string name;
   int number_args; // Should also be negative -> -1 for unknown number
   std::vector<std::shared_ptr<ExpressionNode>> arguments;
-  CallbackFunction callback;
+
+  //! The callback bound to this call when parsing
+  std::shared_ptr<const FunctionStorage::FunctionData> function;
 
   explicit FunctionNode(nonstd::string_view name, size_t pos) : ExpressionNode(pos), precedence(8), associativity(Associativity::Left), operation(Op::Callback), name(name), number_args(1) { }
   explicit FunctionNode(Op operation, size_t pos) : ExpressionNode(pos), operation(operation), number_args(1) {
@@ -276,6 +297,12 @@ public:
   BlockNode body;
   BlockNode *const parent;
 
+  //! Whether the body reads loop.*; the renderer only keeps it up to date if so
+  bool uses_loop_data {false};
+
+  //! Whether iterations may be rendered concurrently, see ThreadPool; the parser rejects set statements in the body
+  bool parallel {false};
+
   ForStatementNode(BlockNode *const parent, size_t pos) : StatementNode(pos), parent(parent) { }
 
   virtual void accept(NodeVisitor& v) const = 0;
@@ -326,7 +353,12 @@ class IncludeStatementNode : public StatementNode {
 public:
   const std::string file;
 
+  //! The template named by file, if it was parsed completely before this node. Otherwise it is looked up when rendering
+  const std::shared_ptr<const Template> resolved;
+
   explicit IncludeStatementNode(const std::string& file, size_t pos) : StatementNode(pos), file(file) { }
+  explicit IncludeStatementNode(const std::string& file, std::shared_ptr<const Template> resolved, size_t pos)
+      : StatementNode(pos), file(file), resolved(std::move(resolved)) { }
 
   void accept(NodeVisitor& v) const {
     v.visit(*this);
@@ -337,7 +369,12 @@ class ExtendsStatementNode : public StatementNode {
 public:
   const std::string file;
 
+  //! The template named by file, if it was parsed completely before this node. Otherwise it is looked up when rendering
+  const std::shared_ptr<const Template> resolved;
+
   explicit ExtendsStatementNode(const std::string& file, size_t pos) : StatementNode(pos), file(file) { }
+  explicit ExtendsStatementNode(const std::string& file, std::shared_ptr<const Template> resolved, size_t pos)
+      : StatementNode(pos), file(file), resolved(std::move(resolved)) { }
 
   void accept(NodeVisitor& v) const {
     v.visit(*this);
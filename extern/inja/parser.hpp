@@ -1,13 +1,16 @@
 #ifndef INCLUDE_INJA_PARSER_HPP_
 #define INCLUDE_INJA_PARSER_HPP_
 
+#include <algorithm>
 #include <limits>
+#include <memory>
 #include <stack>
 #include <string>
 #include <utility>
 #include <queue>
 #include <vector>
 
+#include "bytecode.hpp"
 #include "config.hpp"
 #include "exceptions.hpp"
 #include "function_storage.hpp"
@@ -47,13 +50,45 @@ class Parser {
 
   std::stack<std::shared_ptr<FunctionNode>> operator_stack;
   std::stack<IfStatementNode*> if_statement_stack;
-  std::stack<ForStatementNode*> for_statement_stack;
+  std::vector<ForStatementNode*> for_statement_stack;
   std::stack<BlockStatementNode*> block_statement_stack;
 
+  // Names bound by the enclosing for loops, in the order the renderer binds them
+  std::vector<std::string> loop_variables;
+  std::stack<std::vector<std::string>> block_loop_variables;
+
+  // The template being parsed and the ones including it, which are not complete yet
+  std::vector<const Template*> unfinished;
+
   inline void throw_parser_error(const std::string &message) {
     INJA_THROW(ParserError(message, lexer.current_position()));
   }
 
+  int find_loop_variable(const std::string &name) const {
+    for (size_t i = loop_variables.size(); i > 0; --i) {
+      if (loop_variables[i - 1] == name) {
+        return static_cast<int>(i - 1);
+      }
+    }
+    return -1;
+  }
+
+  // Marks the innermost loop, or all enclosing loops, as reading loop.*. Outside
+  // of loops the data belongs to the loop the template is included from
+  void use_loop_data(Template &tmpl, bool all_loops) {
+    if (for_statement_stack.empty()) {
+      tmpl.uses_loop_data = true;
+    } else if (all_loops) {
+      for (auto for_statement : for_statement_stack) {
+        for_statement->uses_loop_data = true;
+      }
+      tmpl.has_local_data = true;
+    } else {
+      for_statement_stack.back()->uses_loop_data = true;
+      tmpl.has_local_data = true;
+    }
+  }
+
   inline void get_next_token() {
     if (have_peek_tok) {
       tok = peek_tok;
@@ -95,13 +130,22 @@ class Parser {
       }
 
       if (template_storage.find(template_name) == template_storage.end()) {
-        auto include_template = Template(load_file(template_name));
+        auto include_template = std::make_shared<Template>(load_file(template_name));
         template_storage.emplace(template_name, include_template);
-        parse_into_template(template_storage[template_name], template_name);
+        parse_into_template(*include_template, template_name);
       }
     }
   }
 
+  // Templates that are still being parsed, eg. by a recursive include, are left to be looked up when rendering
+  std::shared_ptr<const Template> resolve_template(const std::string& template_name) const {
+    const auto included_template = template_storage.find(template_name);
+    if (included_template == template_storage.end() || std::find(unfinished.begin(), unfinished.end(), included_template->second.get()) != unfinished.end()) {
+      return nullptr;
+    }
+    return included_template->second;
+  }
+
   bool parse_expression(Template &tmpl, Token::Kind closing) {
     while (tok.kind != closing && tok.kind != Token::Kind::Eof) {
       // Literals
@@ -172,12 +216,26 @@ class Parser {
 
         // Functions
         } else if (peek_tok.kind == Token::Kind::LeftParen) {
+          if (tok.text == static_cast<decltype(tok.text)>("super")) {
+            use_loop_data(tmpl, true);
+          }
           operator_stack.emplace(std::make_shared<FunctionNode>(static_cast<std::string>(tok.text), tok.text.data() - tmpl.content.c_str()));
           function_stack.emplace(operator_stack.top().get(), current_paren_level);       
 
         // Variables
         } else {
-          arguments.emplace_back(std::make_shared<JsonNode>(static_cast<std::string>(tok.text), tok.text.data() - tmpl.content.c_str()));
+          auto json_node = std::make_shared<JsonNode>(static_cast<std::string>(tok.text), tok.text.data() - tmpl.content.c_str());
+          json_node->slot = find_loop_variable(json_node->keys.front());
+          auto function_data = function_storage.bind(json_node->name, 0);
+          if (function_data && function_data->operation == FunctionStorage::Operation::Callback) {
+            json_node->callback = std::move(function_data);
+          }
+          if (json_node->keys.front() == "loop") {
+            // loop.parent and the condition of a for statement refer to outer loops
+            const bool in_condition = !for_statement_stack.empty() && current_expression_list == &for_statement_stack.back()->condition;
+            use_loop_data(tmpl, json_node->keys.size() < 2 || json_node->keys[1] == "parent" || in_condition);
+          }
+          arguments.emplace_back(json_node);
         }
 
       // Operators
@@ -304,13 +362,13 @@ class Parser {
 
         if (!function_stack.empty() && function_stack.top().second == current_paren_level) {
           auto func = function_stack.top().first;
-          auto function_data = function_storage.find_function(func->name, func->number_args);
-          if (function_data.operation == FunctionStorage::Operation::None) {
+          auto function_data = function_storage.bind(func->name, func->number_args);
+          if (!function_data || function_data->operation == FunctionStorage::Operation::None) {
             throw_parser_error("unknown function " + func->name);
           }
-          func->operation = function_data.operation;
-          if (function_data.operation == FunctionStorage::Operation::Callback) {
-            func->callback = function_data.callback;
+          func->operation = function_data->operation;
+          if (function_data->operation == FunctionStorage::Operation::Callback) {
+            func->function = std::move(function_data);
           }
 
           if (operator_stack.empty()) {
@@ -415,6 +473,11 @@ class Parser {
       current_block->nodes.emplace_back(block_statement_node);
       block_statement_stack.emplace(block_statement_node.get());
       current_block = &block_statement_node->block;
+      use_loop_data(tmpl, true);
+
+      // Blocks can be rendered outside of the loops around them, so their variables are looked up by name
+      block_loop_variables.emplace(std::move(loop_variables));
+      loop_variables.clear();
       auto success = tmpl.block_storage.emplace(block_name, block_statement_node);
       if (!success.second) {
         throw_parser_error("block with the name '" + block_name + "' does already exist");
@@ -432,8 +495,18 @@ class Parser {
 
       current_block = block_statement_data->parent;
       block_statement_stack.pop();
+      loop_variables = std::move(block_loop_variables.top());
+      block_loop_variables.pop();
 
-    } else if (tok.text == static_cast<decltype(tok.text)>("for")) {
+    } else if (tok.text == static_cast<decltype(tok.text)>("for") || tok.text == static_cast<decltype(tok.text)>("parallel")) {
+      // options: parallel for ...
+      const bool parallel = (tok.text == static_cast<decltype(tok.text)>("parallel"));
+      if (parallel) {
+        get_next_token();
+        if (tok.kind != Token::Kind::Id || tok.text != static_cast<decltype(tok.text)>("for")) {
+          throw_parser_error("expected 'for', got '" + tok.describe() + "'");
+        }
+      }
       get_next_token();
 
       // options: for a in arr; for a, b in obj
@@ -463,8 +536,9 @@ class Parser {
         for_statement_node = std::make_shared<ForArrayStatementNode>(static_cast<std::string>(value_token.text), current_block, tok.text.data() - tmpl.content.c_str());
       }
 
+      for_statement_node->parallel = parallel;
       current_block->nodes.emplace_back(for_statement_node);
-      for_statement_stack.emplace(for_statement_node.get());
+      for_statement_stack.emplace_back(for_statement_node.get());
       current_block = &for_statement_node->body;
       current_expression_list = &for_statement_node->condition;
 
@@ -477,16 +551,25 @@ class Parser {
         return false;
       }
 
+      // Bound only now, as the condition is evaluated outside of the loop
+      if (auto for_object_node = dynamic_cast<ForObjectStatementNode*>(for_statement_stack.back())) {
+        loop_variables.push_back(for_object_node->key);
+        loop_variables.push_back(for_object_node->value);
+      } else {
+        loop_variables.push_back(static_cast<ForArrayStatementNode*>(for_statement_stack.back())->value);
+      }
+
     } else if (tok.text == static_cast<decltype(tok.text)>("endfor")) {
       if (for_statement_stack.empty()) {
         throw_parser_error("endfor without matching for");
       }
 
-      auto &for_statement_data = for_statement_stack.top();
+      auto &for_statement_data = for_statement_stack.back();
       get_next_token();
 
       current_block = for_statement_data->parent;
-      for_statement_stack.pop();
+      loop_variables.resize(loop_variables.size() - (dynamic_cast<ForObjectStatementNode*>(for_statement_data) ? 2 : 1));
+      for_statement_stack.pop_back();
 
     } else if (tok.text == static_cast<decltype(tok.text)>("include")) {
       get_next_token();
@@ -498,7 +581,13 @@ class Parser {
       std::string template_name = json::parse(tok.text).get_ref<const std::string &>();
       add_to_template_storage(path, template_name);
 
-      current_block->nodes.emplace_back(std::make_shared<IncludeStatementNode>(template_name, tok.text.data() - tmpl.content.c_str()));
+      // Templates that are not known yet might read the loop data
+      auto included_template = resolve_template(template_name);
+      if (!included_template || included_template->uses_loop_data) {
+        use_loop_data(tmpl, true);
+      }
+
+      current_block->nodes.emplace_back(std::make_shared<IncludeStatementNode>(template_name, std::move(included_template), tok.text.data() - tmpl.content.c_str()));
 
       get_next_token();
 
@@ -511,8 +600,10 @@ class Parser {
 
       std::string template_name = json::parse(tok.text).get_ref<const std::string &>();
       add_to_template_storage(path, template_name);
+      use_loop_data(tmpl, true);
+      tmpl.has_local_data = true;
 
-      current_block->nodes.emplace_back(std::make_shared<ExtendsStatementNode>(template_name, tok.text.data() - tmpl.content.c_str()));
+      current_block->nodes.emplace_back(std::make_shared<ExtendsStatementNode>(template_name, resolve_template(template_name), tok.text.data() - tmpl.content.c_str()));
 
       get_next_token();
 
@@ -523,8 +614,20 @@ class Parser {
         throw_parser_error("expected variable name, got '" + tok.describe() + "'");
       }
 
+      // Each iteration of a parallel loop has its own copy of the variables, so one could not see another's set
+      for (const auto for_statement : for_statement_stack) {
+        if (for_statement->parallel) {
+          throw_parser_error("set is not allowed in a parallel for loop");
+        }
+      }
+
       std::string key = static_cast<std::string>(tok.text);
+      const std::string root_key = key.substr(0, key.find('.'));
+      if (find_loop_variable(root_key) >= 0) {
+        throw_parser_error("cannot set loop variable '" + root_key + "'");
+      }
       get_next_token();
+      tmpl.has_local_data = true;
 
       auto set_statement_node = std::make_shared<SetStatementNode>(key, tok.text.data() - tmpl.content.c_str());
       current_block->nodes.emplace_back(set_statement_node);
@@ -546,6 +649,7 @@ class Parser {
   }
 
   void parse_into(Template &tmpl, nonstd::string_view path) {
+    unfinished.push_back(&tmpl);
     lexer.start(tmpl.content);
     current_block = &tmpl.root;
 
@@ -559,6 +663,10 @@ class Parser {
         if (!for_statement_stack.empty()) {
           throw_parser_error("unmatched for");
         }
+        if (config.compile_bytecode) {
+          tmpl.bytecode = BytecodeCompiler().compile(tmpl.root, tmpl.content);
+        }
+        unfinished.pop_back();
       } return;
       case Token::Kind::Text: {
         current_block->nodes.emplace_back(std::make_shared<TextNode>(tok.text.data() - tmpl.content.c_str(), tok.text.size()));
@@ -629,7 +737,9 @@ public:
     nonstd::string_view path = filename.substr(0, filename.find_last_of("/\\") + 1);
 
     // StringRef path = sys::path::parent_path(filename);
+    tmpl.name = static_cast<std::string>(filename);
     auto sub_parser = Parser(config, lexer.get_config(), template_storage, function_storage);
+    sub_parser.unfinished = unfinished;
     sub_parser.parse_into(tmpl, path);
   }
 
@@ -0,0 +1,188 @@
+#ifndef INCLUDE_INJA_PROFILER_HPP_
+#define INCLUDE_INJA_PROFILER_HPP_
+
+#include <algorithm>
+#include <cstdint>
+#include <iomanip>
+#include <mutex>
+#include <ostream>
+#include <streambuf>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "node.hpp"
+#include "template.hpp"
+#include "utils.hpp"
+
+
+namespace inja {
+
+/*!
+ * \brief Stream buffer that passes everything on to another one and counts the bytes written.
+ *
+ * The profiler measures the output of every node with it, as positions from tellp() are only known for seekable
+ * streams.
+ */
+class CountingBuffer : public std::streambuf {
+  std::streambuf *target {nullptr};
+  int64_t written {0};
+
+protected:
+  int_type overflow(int_type c) override {
+    if (traits_type::eq_int_type(c, traits_type::eof())) {
+      return traits_type::not_eof(c);
+    }
+    if (traits_type::eq_int_type(target->sputc(traits_type::to_char_type(c)), traits_type::eof())) {
+      return traits_type::eof();
+    }
+    written += 1;
+    return c;
+  }
+
+  std::streamsize xsputn(const char *s, std::streamsize n) override {
+    const std::streamsize put = target->sputn(s, n);
+    written += put;
+    return put;
+  }
+
+  int sync() override {
+    return target->pubsync();
+  }
+
+public:
+  void reset(std::streambuf *buffer) {
+    target = buffer;
+    written = 0;
+  }
+
+  int64_t count() const {
+    return written;
+  }
+};
+
+/*!
+ * \brief Time and output of every statement and callback rendered while it is set in the RenderConfig.
+ *
+ * Statements are timed from the block they are in, callbacks where they are called. The self time of a statement
+ * excludes the statements and callbacks it renders itself, so self times add up to the total render time. Renderers
+ * collect their measurements on their own and add them here when they are destroyed, so one profiler can be shared by
+ * renderers on any number of threads. Profiled templates are rendered from their AST and without parallel loops, so
+ * that every node is timed on its own.
+ */
+class RenderProfiler {
+public:
+  //! Measurements of one node, as collected by a single renderer
+  struct Statistics {
+    const Template *tmpl {nullptr};
+    size_t calls {0};
+    int64_t total_ns {0};
+    int64_t self_ns {0};
+    int64_t bytes {0};
+  };
+
+  using NodeStatistics = std::unordered_map<const AstNode*, Statistics>;
+
+private:
+  struct Entry {
+    std::string location;
+    std::string description;
+    size_t calls {0};
+    int64_t total_ns {0};
+    int64_t self_ns {0};
+    int64_t bytes {0};
+  };
+
+  mutable std::mutex mutex;
+  std::vector<Entry> entries;
+  std::unordered_map<const AstNode*, size_t> entry_of_node;
+
+  static std::string describe(const AstNode &node) {
+    if (dynamic_cast<const TextNode*>(&node)) {
+      return "text";
+    } else if (dynamic_cast<const ExpressionListNode*>(&node)) {
+      return "print";
+    } else if (dynamic_cast<const ForStatementNode*>(&node)) {
+      return "for";
+    } else if (dynamic_cast<const IfStatementNode*>(&node)) {
+      return "if";
+    } else if (const auto include = dynamic_cast<const IncludeStatementNode*>(&node)) {
+      return "include " + include->file;
+    } else if (const auto extends = dynamic_cast<const ExtendsStatementNode*>(&node)) {
+      return "extends " + extends->file;
+    } else if (const auto block = dynamic_cast<const BlockStatementNode*>(&node)) {
+      return "block " + block->name;
+    } else if (const auto set = dynamic_cast<const SetStatementNode*>(&node)) {
+      return "set " + set->key;
+    } else if (const auto function = dynamic_cast<const FunctionNode*>(&node)) {
+      return "callback " + function->name;
+    } else if (const auto variable = dynamic_cast<const JsonNode*>(&node)) {
+      return "callback " + static_cast<std::string>(variable->name);
+    }
+    return "node";
+  }
+
+  static std::string locate(const Template *tmpl, const AstNode &node) {
+    if (!tmpl) {
+      return "?";
+    }
+    const SourceLocation loc = get_source_location(tmpl->content, node.pos);
+    return (tmpl->name.empty() ? "<string>" : tmpl->name) + ":" + std::to_string(loc.line) + ":" + std::to_string(loc.column);
+  }
+
+public:
+  void add(const NodeStatistics &statistics) {
+    std::lock_guard<std::mutex> lock {mutex};
+    for (const auto &measured : statistics) {
+      auto entry_it = entry_of_node.find(measured.first);
+      if (entry_it == entry_of_node.end()) {
+        entry_it = entry_of_node.emplace(measured.first, entries.size()).first;
+        entries.push_back({locate(measured.second.tmpl, *measured.first), describe(*measured.first)});
+      }
+
+      Entry &entry = entries[entry_it->second];
+      entry.calls += measured.second.calls;
+      entry.total_ns += measured.second.total_ns;
+      entry.self_ns += measured.second.self_ns;
+      entry.bytes += measured.second.bytes;
+    }
+  }
+
+  void clear() {
+    std::lock_guard<std::mutex> lock {mutex};
+    entries.clear();
+    entry_of_node.clear();
+  }
+
+  /// Writes the nodes with the highest self time first, at most limit of them
+  void write_report(std::ostream &os, size_t limit = 25) const {
+    std::vector<Entry> sorted;
+    {
+      std::lock_guard<std::mutex> lock {mutex};
+      sorted = entries;
+    }
+    std::sort(sorted.begin(), sorted.end(), [](const Entry &a, const Entry &b) { return a.self_ns > b.self_ns; });
+
+    int64_t render_ns {0};
+    for (const auto &entry : sorted) {
+      render_ns += entry.self_ns;
+    }
+
+    const auto flags = os.flags();
+    os << std::fixed << std::setprecision(3);
+    os << "  self %     self ms    total ms       calls       bytes  node\n";
+    for (size_t i = 0; i < std::min(limit, sorted.size()); ++i) {
+      const Entry &entry = sorted[i];
+      os << std::setw(7) << std::setprecision(1) << (render_ns ? 100.0 * entry.self_ns / render_ns : 0.0) << "%"
+         << std::setprecision(3) << std::setw(12) << entry.self_ns / 1e6 << std::setw(12) << entry.total_ns / 1e6
+         << std::setw(12) << entry.calls << std::setw(12) << entry.bytes << "  " << entry.location << " "
+         << entry.description << "\n";
+    }
+    os << "  render " << render_ns / 1e6 << " ms in " << sorted.size() << " nodes\n";
+    os.flags(flags);
+  }
+};
+
+} // namespace inja
+
+#endif // INCLUDE_INJA_PROFILER_HPP_
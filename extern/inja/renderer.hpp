@@ -2,6 +2,10 @@
 #define INCLUDE_INJA_RENDERER_HPP_
 
 #include <algorithm>
+#include <cctype>
+#include <chrono>
+#include <deque>
+#include <memory>
 #include <numeric>
 #include <string>
 #include <utility>
@@ -10,13 +14,67 @@
 #include <nlohmann/json.hpp>
 
 #include "config.hpp"
+#include "bytecode.hpp"
 #include "exceptions.hpp"
 #include "node.hpp"
+#include "profiler.hpp"
 #include "template.hpp"
+#include "thread_pool.hpp"
 #include "utils.hpp"
 
 namespace inja {
 
+/*!
+ * \brief Storage for the temporary values created while evaluating expressions.
+ *
+ * Values are kept in fixed size chunks so pointers to them stay valid as more are
+ * added. A Scope rewinds the slab to where it was when the scope began, so memory
+ * follows the nesting depth of statements instead of the total work, and chunks
+ * (one slab per thread) are reused by later statements and renders.
+ */
+class JsonSlab {
+  static constexpr size_t chunk_size {64};
+
+  std::vector<std::unique_ptr<json[]>> chunks;
+  size_t used {0};
+
+public:
+  class Scope {
+    JsonSlab &slab;
+    const size_t mark;
+
+  public:
+    explicit Scope(JsonSlab &slab): slab(slab), mark(slab.used) { }
+    Scope(const Scope&) = delete;
+    Scope& operator=(const Scope&) = delete;
+    ~Scope() { slab.used = mark; }
+  };
+
+  static JsonSlab& for_this_thread() {
+    thread_local JsonSlab slab;
+    return slab;
+  }
+
+  size_t mark() const {
+    return used;
+  }
+
+  void rewind(size_t mark) {
+    used = mark;
+  }
+
+  template<typename T>
+  json* emplace(T&& value) {
+    if (used == chunks.size() * chunk_size) {
+      chunks.emplace_back(new json[chunk_size]);
+    }
+    json *slot = &chunks[used / chunk_size][used % chunk_size];
+    *slot = std::forward<T>(value);
+    ++used;
+    return slot;
+  }
+};
+
 /*!
  * \brief Class for rendering a Template with data.
  */
@@ -32,18 +90,74 @@ class Renderer : public NodeVisitor  {
   std::vector<const Template*> template_stack;
   std::vector<const BlockStatementNode*> block_statement_stack;
 
+  // Entries below the bases belong to the templates an included template is rendered from
+  size_t template_stack_base {0};
+  size_t block_statement_base {0};
+
   const json *json_input;
   std::ostream *output_stream;
 
   json json_additional_data;
   json* current_loop_data = &json_additional_data["loop"];
 
-  std::vector<std::shared_ptr<json>> json_tmp_stack;
+  JsonSlab &json_tmp {JsonSlab::for_this_thread()};
   std::stack<const json*> json_eval_stack;
   std::stack<const JsonNode*> not_found_stack;
 
+  struct LoopSlot {
+    const std::string *name;
+    const json *value;
+  };
+
+  // Values of the enclosing loop variables, indexed by JsonNode::slot from loop_slot_base.
+  // Slots below the base belong to outer blocks or the including template
+  std::vector<LoopSlot> loop_slots;
+  size_t loop_slot_base {0};
+
   bool break_rendering {false};
 
+  // Set when a variable is found among the set variables, see pin_local
+  bool read_set_variable {false};
+
+  // Set while compiled code calls a function whose arguments it has already pushed onto json_eval_stack
+  bool arguments_on_stack {false};
+
+  // Measurements for config.profiler, with the time spent in the children of every node being measured
+  RenderProfiler::NodeStatistics node_statistics;
+  std::vector<int64_t> profile_children_ns;
+
+  // While profiling, output goes through profile_output to be counted on its way to the stream rendered to
+  CountingBuffer profile_counter;
+  std::ostream profile_output {nullptr};
+
+  int64_t output_position() const {
+    return profile_counter.count();
+  }
+
+  template<typename F>
+  void profile(const AstNode& node, const F& render) {
+    const Template *tmpl = current_template;
+    const auto start = std::chrono::steady_clock::now();
+    const int64_t start_position = output_position();
+    profile_children_ns.push_back(0);
+
+    render();
+
+    const int64_t children_ns = profile_children_ns.back();
+    profile_children_ns.pop_back();
+    const int64_t total_ns = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+
+    auto &statistics = node_statistics[&node];
+    statistics.tmpl = tmpl;
+    statistics.calls += 1;
+    statistics.total_ns += total_ns;
+    statistics.self_ns += total_ns - children_ns;
+    statistics.bytes += output_position() - start_position;
+    if (!profile_children_ns.empty()) {
+      profile_children_ns.back() += total_ns;
+    }
+  }
+
   bool truthy(const json* data) const {
     if (data->is_boolean()) {
       return data->get<bool>();
@@ -55,9 +169,16 @@ class Renderer : public NodeVisitor  {
     return !data->empty();
   }
 
-  void print_json(const std::shared_ptr<json> value) {
+  template<typename T>
+  void push_result(T&& value) {
+    json_eval_stack.push(json_tmp.emplace(std::forward<T>(value)));
+  }
+
+  void print_json(const json* value) {
     if (value->is_string()) {
       *output_stream << value->get_ref<const json::string_t&>();
+    } else if (value->is_number_unsigned()) {
+      *output_stream << value->get<const json::number_unsigned_t>();
     } else if (value->is_number_integer()) {
       *output_stream << value->get<const json::number_integer_t>();
     } else if (value->is_null()) {
@@ -66,7 +187,9 @@ class Renderer : public NodeVisitor  {
     }
   }
 
-  const std::shared_ptr<json> eval_expression_list(const ExpressionListNode& expression_list) {
+  // The result stays valid until the enclosing JsonSlab::Scope ends, unless it lies within the set variables, which the
+  // next set statement may replace. Statements that render others with it first pin it with pin_local
+  const json* eval_expression_list(const ExpressionListNode& expression_list) {
     if (!expression_list.root) {
       throw_renderer_error("empty expression", expression_list);
     }
@@ -92,7 +215,42 @@ class Renderer : public NodeVisitor  {
 
       throw_renderer_error("variable '" + static_cast<std::string>(node->name) + "' not found", *node);
     }
-    return std::make_shared<json>(*result);
+    return result;
+  }
+
+  // Follows the keys of a variable, starting at the given one, in a single traversal
+  static const json* find_path(const json* data, const JsonNode& node, size_t first) {
+    for (size_t i = first; data && i < node.keys.size(); ++i) {
+      const std::string &key = node.keys[i];
+      if (data->is_object()) {
+        const auto it = data->find(key);
+        data = (it != data->end()) ? &*it : nullptr;
+      } else if (data->is_array() && !key.empty() && std::all_of(key.begin(), key.end(), ::isdigit)) {
+        const size_t index = std::stoul(key);
+        data = (index < data->size()) ? &(*data)[index] : nullptr;
+      } else {
+        data = nullptr;
+      }
+    }
+    return data;
+  }
+
+  // The value of an expression that read a set variable since read_set_variable was cleared, copied into the slab
+  // as it may point into the set variables. Either way it stays valid until the enclosing JsonSlab::Scope ends
+  const json* pin_local(const json* value) {
+    return read_set_variable ? json_tmp.emplace(*value) : value;
+  }
+
+  // Variables that were not resolved at parse time, eg. in included templates
+  const json* find_named(const JsonNode& node) {
+    for (auto slot = loop_slots.rbegin(); slot != loop_slots.rend(); ++slot) {
+      if (*slot->name == node.keys.front()) {
+        return find_path(slot->value, node, 1);
+      }
+    }
+    const json *value = find_path(&json_additional_data, node, 0);
+    read_set_variable |= value != nullptr;
+    return value;
   }
 
   void throw_renderer_error(const std::string &message, const AstNode& node) {
@@ -106,8 +264,10 @@ class Renderer : public NodeVisitor  {
       throw_renderer_error("function needs " + std::to_string(N_start + N) + " variables, but has only found " + std::to_string(node.arguments.size()), node);
     }
 
-    for (size_t i = N_start; i < N_start + N; i += 1) {
-      node.arguments[i]->accept(*this);
+    if (!arguments_on_stack) {
+      for (size_t i = N_start; i < N_start + N; i += 1) {
+        node.arguments[i]->accept(*this);
+      }
     }
 
     if (json_eval_stack.size() < N) {
@@ -134,8 +294,10 @@ class Renderer : public NodeVisitor  {
   template<bool throw_not_found=true>
   Arguments get_argument_vector(const FunctionNode& node) {
     const size_t N = node.arguments.size();
-    for (auto a: node.arguments) {
-      a->accept(*this);
+    if (!arguments_on_stack) {
+      for (auto a: node.arguments) {
+        a->accept(*this);
+      }
     }
 
     if (json_eval_stack.size() < N) {
@@ -159,9 +321,21 @@ class Renderer : public NodeVisitor  {
     return result;
   }
 
+  // Renders a block parsed on its own, whose loop slots are numbered from zero
+  void render_block(const BlockNode& block) {
+    const size_t old_base = loop_slot_base;
+    loop_slot_base = loop_slots.size();
+    block.accept(*this);
+    loop_slot_base = old_base;
+  }
+
   void visit(const BlockNode& node) {
     for (auto& n : node.nodes) {
-      n->accept(*this);
+      if (config.profiler) {
+        profile(*n, [&] { n->accept(*this); });
+      } else {
+        n->accept(*this);
+      }
 
       if (break_rendering) {
         break;
@@ -180,20 +354,24 @@ class Renderer : public NodeVisitor  {
   }
 
   void visit(const JsonNode& node) {
-    if (json_additional_data.contains(node.ptr)) {
-      json_eval_stack.push(&(json_additional_data[node.ptr]));
+    const json *value = (node.slot >= 0) ? find_path(loop_slots[loop_slot_base + node.slot].value, node, 1) : find_named(node);
+    if (!value) {
+      value = find_path(json_input, node, 0);
+    }
 
-    } else if (json_input->contains(node.ptr)) {
-      json_eval_stack.push(&(*json_input)[node.ptr]);
+    if (value) {
+      json_eval_stack.push(value);
 
     } else {
-      // Try to evaluate as a no-argument callback
-      const auto function_data = function_storage.find_function(node.name, 0);
+      // Try to evaluate as a no-argument callback, which is looked up here if it was added after parsing
+      const auto &function_data = node.callback ? *node.callback : function_storage.find_function(node.name, 0);
       if (function_data.operation == FunctionStorage::Operation::Callback) {
         Arguments empty_args {};
-        const auto value = std::make_shared<json>(function_data.callback(empty_args));
-        json_tmp_stack.push_back(value);
-        json_eval_stack.push(value.get());
+        if (config.profiler) {
+          profile(node, [&] { push_result(function_data.callback(empty_args)); });
+        } else {
+          push_result(function_data.callback(empty_args));
+        }
 
       } else {
         json_eval_stack.push(nullptr);
@@ -203,130 +381,91 @@ class Renderer : public NodeVisitor  {
   }
 
   void visit(const FunctionNode& node) {
-    std::shared_ptr<json> result_ptr;
-
     switch (node.operation) {
     case Op::Not: {
       const auto args = get_arguments<1>(node);
-      result_ptr = std::make_shared<json>(!truthy(args[0]));
-      json_tmp_stack.push_back(result_ptr);
-      json_eval_stack.push(result_ptr.get());
+      push_result(!truthy(args[0]));
     } break;
     case Op::And: {
-      result_ptr = std::make_shared<json>(truthy(get_arguments<1, 0>(node)[0]) && truthy(get_arguments<1, 1>(node)[0]));
-      json_tmp_stack.push_back(result_ptr);
-      json_eval_stack.push(result_ptr.get());
+      push_result(truthy(get_arguments<1, 0>(node)[0]) && truthy(get_arguments<1, 1>(node)[0]));
     } break;
     case Op::Or: {
-      result_ptr = std::make_shared<json>(truthy(get_arguments<1, 0>(node)[0]) || truthy(get_arguments<1, 1>(node)[0]));
-      json_tmp_stack.push_back(result_ptr);
-      json_eval_stack.push(result_ptr.get());
+      push_result(truthy(get_arguments<1, 0>(node)[0]) || truthy(get_arguments<1, 1>(node)[0]));
     } break;
     case Op::In: {
       const auto args = get_arguments<2>(node);
-      result_ptr = std::make_shared<json>(std::find(args[1]->begin(), args[1]->end(), *args[0]) != args[1]->end());
-      json_tmp_stack.push_back(result_ptr);
-      json_eval_stack.push(result_ptr.get());
+      push_result(std::find(args[1]->begin(), args[1]->end(), *args[0]) != args[1]->end());
     } break;
     case Op::Equal: {
       const auto args = get_arguments<2>(node);
-      result_ptr = std::make_shared<json>(*args[0] == *args[1]);
-      json_tmp_stack.push_back(result_ptr);
-      json_eval_stack.push(result_ptr.get());
+      push_result(*args[0] == *args[1]);
     } break;
     case Op::NotEqual: {
       const auto args = get_arguments<2>(node);
-      result_ptr = std::make_shared<json>(*args[0] != *args[1]);
-      json_tmp_stack.push_back(result_ptr);
-      json_eval_stack.push(result_ptr.get());
+      push_result(*args[0] != *args[1]);
     } break;
     case Op::Greater: {
       const auto args = get_arguments<2>(node);
-      result_ptr = std::make_shared<json>(*args[0] > *args[1]);
-      json_tmp_stack.push_back(result_ptr);
-      json_eval_stack.push(result_ptr.get());
+      push_result(*args[0] > *args[1]);
     } break;
     case Op::GreaterEqual: {
       const auto args = get_arguments<2>(node);
-      result_ptr = std::make_shared<json>(*args[0] >= *args[1]);
-      json_tmp_stack.push_back(result_ptr);
-      json_eval_stack.push(result_ptr.get());
+      push_result(*args[0] >= *args[1]);
     } break;
     case Op::Less: {
       const auto args = get_arguments<2>(node);
-      result_ptr = std::make_shared<json>(*args[0] < *args[1]);
-      json_tmp_stack.push_back(result_ptr);
-      json_eval_stack.push(result_ptr.get());
+      push_result(*args[0] < *args[1]);
     } break;
     case Op::LessEqual: {
       const auto args = get_arguments<2>(node);
-      result_ptr = std::make_shared<json>(*args[0] <= *args[1]);
-      json_tmp_stack.push_back(result_ptr);
-      json_eval_stack.push(result_ptr.get());
+      push_result(*args[0] <= *args[1]);
     } break;
     case Op::Add: {
       const auto args = get_arguments<2>(node);
       if (args[0]->is_string() && args[1]->is_string()) {
-        result_ptr = std::make_shared<json>(args[0]->get_ref<const std::string&>() + args[1]->get_ref<const std::string&>());
-        json_tmp_stack.push_back(result_ptr);
+        push_result(args[0]->get_ref<const std::string&>() + args[1]->get_ref<const std::string&>());
       } else if (args[0]->is_number_integer() && args[1]->is_number_integer()) {
-        result_ptr = std::make_shared<json>(args[0]->get<int>() + args[1]->get<int>());
-        json_tmp_stack.push_back(result_ptr);
+        push_result(args[0]->get<int>() + args[1]->get<int>());
       } else {
-        result_ptr = std::make_shared<json>(args[0]->get<double>() + args[1]->get<double>());
-        json_tmp_stack.push_back(result_ptr);
+        push_result(args[0]->get<double>() + args[1]->get<double>());
       }
-      json_eval_stack.push(result_ptr.get());
     } break;
     case Op::Subtract: {
       const auto args = get_arguments<2>(node);
       if (args[0]->is_number_integer() && args[1]->is_number_integer()) {
-        result_ptr = std::make_shared<json>(args[0]->get<int>() - args[1]->get<int>());
-        json_tmp_stack.push_back(result_ptr);
+        push_result(args[0]->get<int>() - args[1]->get<int>());
       } else {
-        result_ptr = std::make_shared<json>(args[0]->get<double>() - args[1]->get<double>());
-        json_tmp_stack.push_back(result_ptr);
+        push_result(args[0]->get<double>() - args[1]->get<double>());
       }
-      json_eval_stack.push(result_ptr.get());
     } break;
     case Op::Multiplication: {
       const auto args = get_arguments<2>(node);
       if (args[0]->is_number_integer() && args[1]->is_number_integer()) {
-        result_ptr = std::make_shared<json>(args[0]->get<int>() * args[1]->get<int>());
-        json_tmp_stack.push_back(result_ptr);
+        push_result(args[0]->get<int>() * args[1]->get<int>());
       } else {
-        result_ptr = std::make_shared<json>(args[0]->get<double>() * args[1]->get<double>());
-        json_tmp_stack.push_back(result_ptr);
+        push_result(args[0]->get<double>() * args[1]->get<double>());
       }
-      json_eval_stack.push(result_ptr.get());
     } break;
     case Op::Division: {
       const auto args = get_arguments<2>(node);
       if (args[1]->get<double>() == 0) {
         throw_renderer_error("division by zero", node);
       }
-      result_ptr = std::make_shared<json>(args[0]->get<double>() / args[1]->get<double>());
-      json_tmp_stack.push_back(result_ptr);
-      json_eval_stack.push(result_ptr.get());
+      push_result(args[0]->get<double>() / args[1]->get<double>());
     } break;
     case Op::Power: {
       const auto args = get_arguments<2>(node);
       if (args[0]->is_number_integer() && args[1]->get<int>() >= 0) {
         int result = static_cast<int>(std::pow(args[0]->get<int>(), args[1]->get<int>()));
-        result_ptr = std::make_shared<json>(std::move(result));
-        json_tmp_stack.push_back(result_ptr);
+        push_result(std::move(result));
       } else {
         double result = std::pow(args[0]->get<double>(), args[1]->get<int>());
-        result_ptr = std::make_shared<json>(std::move(result));
-        json_tmp_stack.push_back(result_ptr);
+        push_result(std::move(result));
       }
-      json_eval_stack.push(result_ptr.get());
     } break;
     case Op::Modulo: {
       const auto args = get_arguments<2>(node);
-      result_ptr = std::make_shared<json>(args[0]->get<int>() % args[1]->get<int>());
-      json_tmp_stack.push_back(result_ptr);
-      json_eval_stack.push(result_ptr.get());
+      push_result(args[0]->get<int>() % args[1]->get<int>());
     } break;
     case Op::AtId: {
       const auto container = get_arguments<1, 0, false>(node)[0];
@@ -354,41 +493,29 @@ class Renderer : public NodeVisitor  {
     case Op::DivisibleBy: {
       const auto args = get_arguments<2>(node);
       const int divisor = args[1]->get<int>();
-      result_ptr = std::make_shared<json>((divisor != 0) && (args[0]->get<int>() % divisor == 0));
-      json_tmp_stack.push_back(result_ptr);
-      json_eval_stack.push(result_ptr.get());
+      push_result((divisor != 0) && (args[0]->get<int>() % divisor == 0));
     } break;
     case Op::Even: {
-      result_ptr = std::make_shared<json>(get_arguments<1>(node)[0]->get<int>() % 2 == 0);
-      json_tmp_stack.push_back(result_ptr);
-      json_eval_stack.push(result_ptr.get());
+      push_result(get_arguments<1>(node)[0]->get<int>() % 2 == 0);
     } break;
     case Op::Exists: {
       auto &&name = get_arguments<1>(node)[0]->get_ref<const std::string &>();
-      result_ptr = std::make_shared<json>(json_input->contains(json::json_pointer(JsonNode::convert_dot_to_json_ptr(name))));
-      json_tmp_stack.push_back(result_ptr);
-      json_eval_stack.push(result_ptr.get());
+      push_result(json_input->contains(json::json_pointer(JsonNode::convert_dot_to_json_ptr(name))));
     } break;
     case Op::ExistsInObject: {
       const auto args = get_arguments<2>(node);
       auto &&name = args[1]->get_ref<const std::string &>();
-      result_ptr = std::make_shared<json>(args[0]->find(name) != args[0]->end());
-      json_tmp_stack.push_back(result_ptr);
-      json_eval_stack.push(result_ptr.get());
+      push_result(args[0]->find(name) != args[0]->end());
     } break;
     case Op::First: {
       const auto result = &get_arguments<1>(node)[0]->front();
       json_eval_stack.push(result);
     } break;
     case Op::Float: {
-      result_ptr = std::make_shared<json>(std::stod(get_arguments<1>(node)[0]->get_ref<const std::string &>()));
-      json_tmp_stack.push_back(result_ptr);
-      json_eval_stack.push(result_ptr.get());
+      push_result(std::stod(get_arguments<1>(node)[0]->get_ref<const std::string &>()));
     } break;
     case Op::Int: {
-      result_ptr = std::make_shared<json>(std::stoi(get_arguments<1>(node)[0]->get_ref<const std::string &>()));
-      json_tmp_stack.push_back(result_ptr);
-      json_eval_stack.push(result_ptr.get());
+      push_result(std::stoi(get_arguments<1>(node)[0]->get_ref<const std::string &>()));
     } break;
     case Op::Last: {
       const auto result = &get_arguments<1>(node)[0]->back();
@@ -397,19 +524,15 @@ class Renderer : public NodeVisitor  {
     case Op::Length: {
       const auto val = get_arguments<1>(node)[0];
       if (val->is_string()) {
-        result_ptr = std::make_shared<json>(val->get_ref<const std::string &>().length());
+        push_result(val->get_ref<const std::string &>().length());
       } else {
-        result_ptr = std::make_shared<json>(val->size());
+        push_result(val->size());
       }
-      json_tmp_stack.push_back(result_ptr);
-      json_eval_stack.push(result_ptr.get());
     } break;
     case Op::Lower: {
       std::string result = get_arguments<1>(node)[0]->get<std::string>();
       std::transform(result.begin(), result.end(), result.begin(), ::tolower);
-      result_ptr = std::make_shared<json>(std::move(result));
-      json_tmp_stack.push_back(result_ptr);
-      json_eval_stack.push(result_ptr.get());
+      push_result(std::move(result));
     } break;
     case Op::Max: {
       const auto args = get_arguments<1>(node);
@@ -422,82 +545,61 @@ class Renderer : public NodeVisitor  {
       json_eval_stack.push(&(*result));
     } break;
     case Op::Odd: {
-      result_ptr = std::make_shared<json>(get_arguments<1>(node)[0]->get<int>() % 2 != 0);
-      json_tmp_stack.push_back(result_ptr);
-      json_eval_stack.push(result_ptr.get());
+      push_result(get_arguments<1>(node)[0]->get<int>() % 2 != 0);
     } break;
     case Op::Range: {
       std::vector<int> result(get_arguments<1>(node)[0]->get<int>());
       std::iota(result.begin(), result.end(), 0);
-      result_ptr = std::make_shared<json>(std::move(result));
-      json_tmp_stack.push_back(result_ptr);
-      json_eval_stack.push(result_ptr.get());
+      push_result(std::move(result));
     } break;
     case Op::Round: {
       const auto args = get_arguments<2>(node);
       const int precision = args[1]->get<int>();
       const double result = std::round(args[0]->get<double>() * std::pow(10.0, precision)) / std::pow(10.0, precision);
       if(0==precision){
-        result_ptr = std::make_shared<json>(int(result));
+        push_result(int(result));
       }else{
-        result_ptr = std::make_shared<json>(std::move(result));
+        push_result(std::move(result));
       }
-      json_tmp_stack.push_back(result_ptr);
-      json_eval_stack.push(result_ptr.get());
     } break;
     case Op::Sort: {
-      result_ptr = std::make_shared<json>(get_arguments<1>(node)[0]->get<std::vector<json>>());
-      std::sort(result_ptr->begin(), result_ptr->end());
-      json_tmp_stack.push_back(result_ptr);
-      json_eval_stack.push(result_ptr.get());
+      json *result = json_tmp.emplace(get_arguments<1>(node)[0]->get<std::vector<json>>());
+      std::sort(result->begin(), result->end());
+      json_eval_stack.push(result);
     } break;
     case Op::Upper: {
       std::string result = get_arguments<1>(node)[0]->get<std::string>();
       std::transform(result.begin(), result.end(), result.begin(), ::toupper);
-      result_ptr = std::make_shared<json>(std::move(result));
-      json_tmp_stack.push_back(result_ptr);
-      json_eval_stack.push(result_ptr.get());
+      push_result(std::move(result));
     } break;
     case Op::IsBoolean: {
-      result_ptr = std::make_shared<json>(get_arguments<1>(node)[0]->is_boolean());
-      json_tmp_stack.push_back(result_ptr);
-      json_eval_stack.push(result_ptr.get());
+      push_result(get_arguments<1>(node)[0]->is_boolean());
     } break;
     case Op::IsNumber: {
-      result_ptr = std::make_shared<json>(get_arguments<1>(node)[0]->is_number());
-      json_tmp_stack.push_back(result_ptr);
-      json_eval_stack.push(result_ptr.get());
+      push_result(get_arguments<1>(node)[0]->is_number());
     } break;
     case Op::IsInteger: {
-      result_ptr = std::make_shared<json>(get_arguments<1>(node)[0]->is_number_integer());
-      json_tmp_stack.push_back(result_ptr);
-      json_eval_stack.push(result_ptr.get());
+      push_result(get_arguments<1>(node)[0]->is_number_integer());
     } break;
     case Op::IsFloat: {
-      result_ptr = std::make_shared<json>(get_arguments<1>(node)[0]->is_number_float());
-      json_tmp_stack.push_back(result_ptr);
-      json_eval_stack.push(result_ptr.get());
+      push_result(get_arguments<1>(node)[0]->is_number_float());
     } break;
     case Op::IsObject: {
-      result_ptr = std::make_shared<json>(get_arguments<1>(node)[0]->is_object());
-      json_tmp_stack.push_back(result_ptr);
-      json_eval_stack.push(result_ptr.get());
+      push_result(get_arguments<1>(node)[0]->is_object());
     } break;
     case Op::IsArray: {
-      result_ptr = std::make_shared<json>(get_arguments<1>(node)[0]->is_array());
-      json_tmp_stack.push_back(result_ptr);
-      json_eval_stack.push(result_ptr.get());
+      push_result(get_arguments<1>(node)[0]->is_array());
     } break;
     case Op::IsString: {
-      result_ptr = std::make_shared<json>(get_arguments<1>(node)[0]->is_string());
-      json_tmp_stack.push_back(result_ptr);
-      json_eval_stack.push(result_ptr.get());
+      push_result(get_arguments<1>(node)[0]->is_string());
     } break;
     case Op::Callback: {
       auto args = get_argument_vector(node);
-      result_ptr = std::make_shared<json>(node.callback(args));
-      json_tmp_stack.push_back(result_ptr);
-      json_eval_stack.push(result_ptr.get());
+      if (config.profiler) {
+        profile(node, [&] { push_result(node.function->callback(args)); });
+      } else {
+        push_result(node.function->callback(args));
+      }
     } break;
     case Op::Super: {
       const auto args = get_argument_vector(node);
@@ -505,30 +607,29 @@ class Renderer : public NodeVisitor  {
       const size_t level_diff = (args.size() == 1) ? args[0]->get<int>() : 1;
       const size_t level = current_level + level_diff;
 
-      if (block_statement_stack.empty()) {
+      if (block_statement_stack.size() == block_statement_base) {
         throw_renderer_error("super() call is not within a block", node);
       }
 
-      if (level < 1 || level > template_stack.size() - 1) {
-        throw_renderer_error("level of super() call does not match parent templates (between 1 and " + std::to_string(template_stack.size() - 1) + ")", node);
+      const size_t parents = template_stack.size() - template_stack_base - 1;
+      if (level < 1 || level > parents) {
+        throw_renderer_error("level of super() call does not match parent templates (between 1 and " + std::to_string(parents) + ")", node);
       }
 
       const auto current_block_statement = block_statement_stack.back();
-      const Template *new_template = template_stack.at(level);
+      const Template *new_template = template_stack.at(template_stack_base + level);
       const Template *old_template = current_template;
       const auto block_it = new_template->block_storage.find(current_block_statement->name);
       if (block_it != new_template->block_storage.end()) {
         current_template = new_template;
         current_level = level;
-        block_it->second->block.accept(*this);
+        render_block(block_it->second->block);
         current_level = old_level;
         current_template = old_template;
       } else {
         throw_renderer_error("could not find block with name '" + current_block_statement->name + "'", node);
       }
-      result_ptr = std::make_shared<json>(nullptr);
-      json_tmp_stack.push_back(result_ptr);
-      json_eval_stack.push(result_ptr.get());
+      push_result(nullptr);
     } break;
     case Op::Join: {
       const auto args = get_arguments<2>(node);
@@ -544,9 +645,7 @@ class Renderer : public NodeVisitor  {
         }
         sep = separator;
       }
-      result_ptr = std::make_shared<json>(os.str());
-      json_tmp_stack.push_back(result_ptr);
-      json_eval_stack.push(result_ptr.get());
+      push_result(os.str());
     } break;
     case Op::ParenLeft:
     case Op::ParenRight:
@@ -556,6 +655,7 @@ class Renderer : public NodeVisitor  {
   }
 
   void visit(const ExpressionListNode& node) {
+    JsonSlab::Scope scope {json_tmp};
     print_json(eval_expression_list(node));
   }
 
@@ -563,37 +663,24 @@ class Renderer : public NodeVisitor  {
 
   void visit(const ForStatementNode&) { }
 
-  void visit(const ForArrayStatementNode& node) {
-    const auto result = eval_expression_list(node.condition);
-    if (!result->is_array()) {
-      throw_renderer_error("object must be an array", node);
-    }
-
+  void begin_loop_data(size_t size) {
     if (!current_loop_data->empty()) {
       auto tmp = *current_loop_data; // Because of clang-3
       (*current_loop_data)["parent"] = std::move(tmp);
     }
 
-    size_t index = 0;
     (*current_loop_data)["is_first"] = true;
-    (*current_loop_data)["is_last"] = (result->size() <= 1);
-    for (auto it = result->begin(); it != result->end(); ++it) {
-      json_additional_data[static_cast<std::string>(node.value)] = *it;
-
-      (*current_loop_data)["index"] = index;
-      (*current_loop_data)["index1"] = index + 1;
-      if (index == 1) {
-        (*current_loop_data)["is_first"] = false;
-      }
-      if (index == result->size() - 1) {
-        (*current_loop_data)["is_last"] = true;
-      }
+    (*current_loop_data)["is_last"] = (size <= 1);
+  }
 
-      node.body.accept(*this);
-      ++index;
-    }
+  void update_loop_data(size_t index, size_t size) {
+    (*current_loop_data)["index"] = index;
+    (*current_loop_data)["index1"] = index + 1;
+    (*current_loop_data)["is_first"] = (index == 0);
+    (*current_loop_data)["is_last"] = (index == size - 1);
+  }
 
-    json_additional_data[static_cast<std::string>(node.value)].clear();
+  void end_loop_data() {
     if (!(*current_loop_data)["parent"].empty()) {
       const auto tmp = (*current_loop_data)["parent"];
       *current_loop_data = std::move(tmp);
@@ -602,68 +689,192 @@ class Renderer : public NodeVisitor  {
     }
   }
 
-  void visit(const ForObjectStatementNode& node) {
-    const auto result = eval_expression_list(node.condition);
-    if (!result->is_object()) {
+  void check_loop_container(const ForStatementNode& node, const json& container, bool has_key) {
+    if (has_key && !container.is_object()) {
       throw_renderer_error("object must be an object", node);
+    } else if (!has_key && !container.is_array()) {
+      throw_renderer_error("object must be an array", node);
     }
+  }
 
-    if (!current_loop_data->empty()) {
-      (*current_loop_data)["parent"] = std::move(*current_loop_data);
+  static const std::string* loop_key_name(const ForStatementNode& node) {
+    const auto object_loop = dynamic_cast<const ForObjectStatementNode*>(&node);
+    return object_loop ? &object_loop->key : nullptr;
+  }
+
+  static const std::string& loop_value_name(const ForStatementNode& node) {
+    const auto object_loop = dynamic_cast<const ForObjectStatementNode*>(&node);
+    return object_loop ? object_loop->value : static_cast<const ForArrayStatementNode&>(node).value;
+  }
+
+  // Renders the iterations [first, last). Loop variables point into the iterated container, which callers keep valid
+  // until the loop ends, pinning it with pin_local if a set statement could replace it
+  template<typename Body>
+  void render_iterations(const ForStatementNode& node, const json& container, size_t first, size_t last, const Body& body) {
+    if (node.uses_loop_data) {
+      begin_loop_data(container.size());
     }
 
-    size_t index = 0;
-    (*current_loop_data)["is_first"] = true;
-    (*current_loop_data)["is_last"] = (result->size() <= 1);
-    for (auto it = result->begin(); it != result->end(); ++it) {
-      json_additional_data[static_cast<std::string>(node.key)] = it.key();
-      json_additional_data[static_cast<std::string>(node.value)] = it.value();
-
-      (*current_loop_data)["index"] = index;
-      (*current_loop_data)["index1"] = index + 1;
-      if (index == 1) {
-        (*current_loop_data)["is_first"] = false;
+    // Keys are not stored as json, so they are copied into one reused string
+    const std::string *key_name = loop_key_name(node);
+    json key = std::string();
+    auto &key_string = key.get_ref<std::string&>();
+    if (key_name) {
+      loop_slots.push_back({key_name, &key});
+    }
+    const size_t value_slot = loop_slots.size();
+    loop_slots.push_back({&loop_value_name(node), nullptr});
+
+    auto it = std::next(container.begin(), first);
+    for (size_t index = first; index < last; ++index, ++it) {
+      if (key_name) {
+        key_string.assign(it.key());
       }
-      if (index == result->size() - 1) {
-        (*current_loop_data)["is_last"] = true;
+      loop_slots[value_slot].value = &it.value();
+
+      if (node.uses_loop_data) {
+        update_loop_data(index, container.size());
       }
 
-      node.body.accept(*this);
-      ++index;
+      body(*this);
     }
 
-    json_additional_data[static_cast<std::string>(node.key)].clear();
-    json_additional_data[static_cast<std::string>(node.value)].clear();
-    if (!(*current_loop_data)["parent"].empty()) {
-      *current_loop_data = std::move((*current_loop_data)["parent"]);
-    } else {
-      current_loop_data = &json_additional_data["loop"];
+    loop_slots.resize(value_slot - (key_name ? 1 : 0));
+    if (node.uses_loop_data) {
+      end_loop_data();
     }
   }
 
+  // Takes over everything a loop body can read, to render part of a parallel loop on another thread
+  void fork(const Renderer& parent, std::ostream& os) {
+    output_stream = &os;
+    current_template = parent.current_template;
+    current_level = parent.current_level;
+    template_stack = parent.template_stack;
+    block_statement_stack = parent.block_statement_stack;
+    template_stack_base = parent.template_stack_base;
+    block_statement_base = parent.block_statement_base;
+    json_input = parent.json_input;
+    json_additional_data = parent.json_additional_data;
+    current_loop_data = &json_additional_data["loop"];
+    loop_slots = parent.loop_slots;
+    loop_slot_base = parent.loop_slot_base;
+  }
+
+  // Parallel loops are split into ranges rendered by their own renderers, whose output is written in order.
+  // They are rendered serially while profiling, so that the time of every iteration is counted in the loop
+  template<typename Body>
+  void render_loop(const ForStatementNode& node, const json& container, const Body& body) {
+    const bool rendered = node.parallel && !config.profiler && ThreadPool::shared().render_in_order(*output_stream, container.size(), [&](std::ostream& os, size_t first, size_t last) {
+      Renderer renderer(config, template_storage, function_storage);
+      renderer.fork(*this, os);
+      renderer.render_iterations(node, container, first, last, body);
+    });
+    if (!rendered) {
+      render_iterations(node, container, 0, container.size(), body);
+    }
+  }
+
+  void visit(const ForArrayStatementNode& node) {
+    JsonSlab::Scope scope {json_tmp};
+    read_set_variable = false;
+    const auto result = pin_local(eval_expression_list(node.condition));
+    check_loop_container(node, *result, false);
+    render_loop(node, *result, [&node](Renderer& renderer) { node.body.accept(renderer); });
+  }
+
+  void visit(const ForObjectStatementNode& node) {
+    JsonSlab::Scope scope {json_tmp};
+    read_set_variable = false;
+    const auto result = pin_local(eval_expression_list(node.condition));
+    check_loop_container(node, *result, true);
+    render_loop(node, *result, [&node](Renderer& renderer) { node.body.accept(renderer); });
+  }
+
   void visit(const IfStatementNode& node) {
+    JsonSlab::Scope scope {json_tmp};
     const auto result = eval_expression_list(node.condition);
-    if (truthy(result.get())) {
+    if (truthy(result)) {
       node.true_statement.accept(*this);
     } else if (node.has_false_statement) {
       node.false_statement.accept(*this);
     }
   }
 
+  // Profiled templates are rendered from their AST, whose nodes are measured
+  void render_template(const Template& tmpl) {
+    if (tmpl.bytecode && !config.profiler) {
+      run(*tmpl.bytecode);
+    } else {
+      render_block(tmpl.root);
+    }
+  }
+
+  // Puts back the set variables an included template changed. Keys it left alone keep their values in place, as the
+  // including template may still point into them
+  void restore_local_data(json& old_data) {
+    for (auto it = json_additional_data.begin(); it != json_additional_data.end();) {
+      const auto old = old_data.find(it.key());
+      if (old == old_data.end()) {
+        it = json_additional_data.erase(it);
+        continue;
+      }
+      if (*it != *old) {
+        *it = std::move(*old);
+      }
+      ++it;
+    }
+    for (auto old = old_data.begin(); old != old_data.end(); ++old) {
+      if (json_additional_data.find(old.key()) == json_additional_data.end()) {
+        json_additional_data[old.key()] = std::move(*old);
+      }
+    }
+  }
+
+  // Renders an included template in this renderer, as if it was rendered on its own with the data of the including
+  // one. Only templates that set variables or loop data of their own need a copy of it
+  void render_included(const Template& tmpl) {
+    const Template *old_template = current_template;
+    const size_t old_level = current_level;
+    const size_t old_template_base = template_stack_base;
+    const size_t old_block_base = block_statement_base;
+    json old_data;
+    if (tmpl.has_local_data) {
+      old_data = json_additional_data;
+    }
+
+    current_template = &tmpl;
+    current_level = 0;
+    template_stack_base = template_stack.size();
+    block_statement_base = block_statement_stack.size();
+    template_stack.push_back(&tmpl);
+
+    render_template(tmpl);
+
+    template_stack.resize(template_stack_base);
+    break_rendering = false;
+    current_template = old_template;
+    current_level = old_level;
+    template_stack_base = old_template_base;
+    block_statement_base = old_block_base;
+    if (tmpl.has_local_data) {
+      restore_local_data(old_data);
+      current_loop_data = &json_additional_data["loop"];
+    }
+  }
+
   void visit(const IncludeStatementNode& node) {
-    auto sub_renderer = Renderer(config, template_storage, function_storage);
-    const auto included_template_it = template_storage.find(node.file);
-    if (included_template_it != template_storage.end()) {
-      sub_renderer.render_to(*output_stream, included_template_it->second, *json_input, &json_additional_data);
+    const Template *included_template = find_template(template_storage, node.file, node.resolved.get());
+    if (included_template) {
+      render_included(*included_template);
     } else if (config.throw_at_missing_includes) {
       throw_renderer_error("include '" + node.file + "' not found", node);
     }
   }
 
   void visit(const ExtendsStatementNode& node) {
-    const auto included_template_it = template_storage.find(node.file);
-    if (included_template_it != template_storage.end()) {
-      const Template *parent_template = &included_template_it->second;
+    const Template *parent_template = find_template(template_storage, node.file, node.resolved.get());
+    if (parent_template) {
       render_to(*output_stream, *parent_template, *json_input, &json_additional_data);
       break_rendering = true;
     } else if (config.throw_at_missing_includes) {
@@ -674,30 +885,281 @@ class Renderer : public NodeVisitor  {
   void visit(const BlockStatementNode& node) {
     const size_t old_level = current_level;
     current_level = 0;
-    current_template = template_stack.front();
+    current_template = template_stack[template_stack_base];
     const auto block_it = current_template->block_storage.find(node.name);
     if (block_it != current_template->block_storage.end()) {
       block_statement_stack.emplace_back(&node);
-      block_it->second->block.accept(*this);
-      block_statement_stack.pop_back(); 
+      render_block(block_it->second->block);
+      block_statement_stack.pop_back();
     }
     current_level = old_level;
     current_template = template_stack.back();
   }
 
-  void visit(const SetStatementNode& node) {
+  // Loop variables are read from their slots, so setting one is an error. The parser rejects it within a loop, this
+  // catches included templates and blocks
+  void set_value(const SetStatementNode& node, const json& value) {
+    const std::string root_key = node.key.substr(0, node.key.find('.'));
+    for (const auto &slot : loop_slots) {
+      if (*slot.name == root_key) {
+        throw_renderer_error("cannot set loop variable '" + root_key + "'", node);
+      }
+    }
+
     std::string ptr = node.key;
     replace_substring(ptr, ".", "/");
     ptr = "/" + ptr;
-    json_additional_data[nlohmann::json::json_pointer(ptr)] = *eval_expression_list(node.expression);
+    json_additional_data[nlohmann::json::json_pointer(ptr)] = value;
+  }
+
+  void visit(const SetStatementNode& node) {
+    JsonSlab::Scope scope {json_tmp};
+    set_value(node, *eval_expression_list(node.expression));
+  }
+
+  static const json* boolean(bool value) {
+    static const json true_value = true;
+    static const json false_value = false;
+    return value ? &true_value : &false_value;
+  }
+
+  struct LoopFrame {
+    const ForStatementNode *node;
+    json::const_iterator it;
+    json::const_iterator end;
+    size_t index;
+    size_t size;
+    size_t value_slot;
+    bool has_key;
+    json key;
+  };
+
+  // The registers, scope marks and loop frames of one nesting depth of execute
+  struct ExecuteState {
+    std::vector<const json*> registers;
+    std::vector<size_t> marks;
+    std::vector<LoopFrame> loops;
+  };
+
+  struct DepthGuard {
+    size_t &depth;
+
+    explicit DepthGuard(size_t &depth): depth(depth) { ++depth; }
+    DepthGuard(const DepthGuard&) = delete;
+    DepthGuard& operator=(const DepthGuard&) = delete;
+    ~DepthGuard() { --depth; }
+  };
+
+  std::deque<ExecuteState> execute_states;
+  size_t execute_depth {0};
+
+  void bind_loop(LoopFrame& frame) {
+    if (frame.has_key) {
+      frame.key.get_ref<std::string&>().assign(frame.it.key());
+    }
+    loop_slots[frame.value_slot].value = &frame.it.value();
+
+    if (frame.node->uses_loop_data) {
+      update_loop_data(frame.index, frame.size);
+    }
+  }
+
+  void end_loop(const LoopFrame& frame) {
+    loop_slots.resize(loop_slots.size() - (frame.has_key ? 2 : 1));
+    if (frame.node->uses_loop_data) {
+      end_loop_data();
+    }
+  }
+
+  // Runs a compiled template with the same semantics as walking its AST
+  void run(const Bytecode& code) {
+    JsonSlab::Scope scope {json_tmp};
+    const size_t old_base = loop_slot_base;
+    loop_slot_base = loop_slots.size();
+    execute(code, 0, code.instructions.size());
+    loop_slot_base = old_base;
+  }
+
+  // Runs the instructions [first, last), eg. the body of a parallel loop
+  void execute(const Bytecode& code, size_t first, size_t last) {
+    // Includes run their code nested in this call, with the state of the next depth. Those are kept in a deque, which
+    // never moves them, and reused by later calls, so running code does not allocate once they are large enough
+    if (execute_depth == execute_states.size()) {
+      execute_states.emplace_back();
+    }
+    ExecuteState &state = execute_states[execute_depth];
+    const DepthGuard depth {execute_depth};
+
+    std::vector<const json*> &registers = state.registers;
+    std::vector<size_t> &marks = state.marks;
+    registers.assign(code.registers, nullptr);
+    marks.assign(code.scopes, 0);
+
+    // Frames are reserved up front, as loop_slots point to their keys
+    std::vector<LoopFrame> &loops = state.loops;
+    loops.clear();
+    loops.reserve(code.loops);
+
+    using Code = Instruction::Op;
+    const Instruction *const begin = code.instructions.data();
+    const Instruction *const end = begin + last;
+    for (const Instruction *pc = begin + first; pc != end;) {
+      const Instruction& in = *pc++;
+      switch (in.op) {
+      case Code::Text: {
+        output_stream->write(code.text.data() + in.a, in.b);
+      } break;
+      case Code::Print: {
+        print_json(registers[in.a]);
+      } break;
+      case Code::Literal: {
+        registers[in.a] = &static_cast<const LiteralNode*>(in.node)->value;
+      } break;
+      case Code::Load: {
+        visit(*static_cast<const JsonNode*>(in.node));
+        registers[in.a] = json_eval_stack.top();
+        json_eval_stack.pop();
+
+        if (!registers[in.a]) {
+          const auto node = not_found_stack.top();
+          not_found_stack.pop();
+          if (!in.b) {
+            throw_renderer_error("variable '" + static_cast<std::string>(node->name) + "' not found", *node);
+          }
+        }
+      } break;
+      case Code::Call: {
+        for (uint32_t i = 0; i < in.c; ++i) {
+          json_eval_stack.push(registers[in.b + i]);
+        }
+        arguments_on_stack = true;
+        visit(*static_cast<const FunctionNode*>(in.node));
+        arguments_on_stack = false;
+        registers[in.a] = json_eval_stack.top();
+        json_eval_stack.pop();
+      } break;
+      case Code::Member: {
+        const auto &id_node = *static_cast<const JsonNode*>(in.node);
+        visit(id_node);
+        const bool found = json_eval_stack.top();
+        json_eval_stack.pop();
+        if (found) {
+          throw_renderer_error("could not find element with given name", id_node);
+        }
+        not_found_stack.pop();
+        registers[in.a] = &registers[in.b]->at(id_node.name);
+      } break;
+      case Code::Truthy: {
+        registers[in.a] = boolean(truthy(registers[in.b]));
+      } break;
+      case Code::Not: {
+        registers[in.a] = boolean(!truthy(registers[in.b]));
+      } break;
+      case Code::Jump: {
+        pc = begin + in.a;
+      } break;
+      case Code::JumpIfFalse: {
+        if (!truthy(registers[in.a])) {
+          pc = begin + in.b;
+        }
+      } break;
+      case Code::JumpIfTrue: {
+        if (truthy(registers[in.a])) {
+          pc = begin + in.b;
+        }
+      } break;
+      case Code::JumpIfFound: {
+        if (registers[in.a]) {
+          pc = begin + in.b;
+        }
+      } break;
+      case Code::LoopBegin: {
+        const auto &node = *static_cast<const ForStatementNode*>(in.node);
+        const json *container = pin_local(registers[in.a]);
+        check_loop_container(node, *container, in.c);
+
+        if (node.uses_loop_data) {
+          begin_loop_data(container->size());
+        }
+
+        loops.push_back({&node, container->cbegin(), container->cend(), 0, container->size(), 0, in.c != 0, json()});
+        LoopFrame &frame = loops.back();
+        if (frame.has_key) {
+          frame.key = std::string();
+          loop_slots.push_back({loop_key_name(node), &frame.key});
+        }
+        frame.value_slot = loop_slots.size();
+        loop_slots.push_back({&loop_value_name(node), nullptr});
+
+        if (frame.it == frame.end) {
+          end_loop(frame);
+          loops.pop_back();
+          pc = begin + in.b;
+        } else {
+          bind_loop(frame);
+        }
+      } break;
+      case Code::LoopNext: {
+        LoopFrame &frame = loops.back();
+        ++frame.it;
+        ++frame.index;
+        if (frame.it == frame.end) {
+          end_loop(frame);
+          loops.pop_back();
+        } else {
+          bind_loop(frame);
+          pc = begin + in.a;
+        }
+      } break;
+      case Code::LoopParallel: {
+        const auto &node = *static_cast<const ForStatementNode*>(in.node);
+        const json *container = pin_local(registers[in.a]);
+        check_loop_container(node, *container, in.c);
+
+        const size_t body = pc - begin;
+        const size_t exit = in.b;
+        render_loop(node, *container, [&code, body, exit](Renderer& renderer) { renderer.execute(code, body, exit); });
+        pc = begin + exit;
+      } break;
+      case Code::Include: {
+        visit(*static_cast<const IncludeStatementNode*>(in.node));
+      } break;
+      case Code::Set: {
+        set_value(*static_cast<const SetStatementNode*>(in.node), *registers[in.a]);
+      } break;
+      case Code::Mark: {
+        // Scopes are marked right before the expressions of their statement
+        read_set_variable = false;
+        marks[in.a] = json_tmp.mark();
+      } break;
+      case Code::Release: {
+        json_tmp.rewind(marks[in.a]);
+      } break;
+      }
+    }
   }
 
 public:
   Renderer(const RenderConfig& config, const TemplateStorage &template_storage, const FunctionStorage &function_storage)
       : config(config), template_storage(template_storage), function_storage(function_storage) { }
 
+  Renderer(const Renderer&) = delete;
+  Renderer& operator=(const Renderer&) = delete;
+
+  ~Renderer() {
+    if (config.profiler && !node_statistics.empty()) {
+      config.profiler->add(node_statistics);
+    }
+  }
+
   void render_to(std::ostream &os, const Template &tmpl, const json &data, json *loop_data = nullptr) {
     output_stream = &os;
+    if (config.profiler && &os != &profile_output) {
+      profile_counter.reset(os.rdbuf());
+      profile_output.copyfmt(os);
+      profile_output.rdbuf(&profile_counter);
+      output_stream = &profile_output;
+    }
     current_template = &tmpl;
     json_input = &data;
     if (loop_data) {
@@ -706,9 +1168,7 @@ public:
     }
 
     template_stack.emplace_back(current_template);
-    current_template->root.accept(*this);
-
-    json_tmp_stack.clear();
+    render_template(*current_template);
   }
 };
 
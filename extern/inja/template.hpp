@@ -6,6 +6,7 @@
 #include <string>
 #include <vector>
 
+#include "bytecode.hpp"
 #include "node.hpp"
 #include "statistics.hpp"
 
@@ -18,8 +19,21 @@ namespace inja {
 struct Template {
   BlockNode root;
   std::string content;
+
+  //! File the template was loaded from, empty for templates parsed from a string
+  std::string name;
+
   std::map<std::string, std::shared_ptr<BlockStatementNode>> block_storage;
 
+  //! Whether the template reads the loop data of the loop it is included from
+  bool uses_loop_data {false};
+
+  //! Whether rendering the template sets variables or loop data, which the template including it must not see
+  bool has_local_data {false};
+
+  //! Compiled form of the template, if it was parsed with bytecode enabled and could be compiled
+  std::shared_ptr<const Bytecode> bytecode;
+
   explicit Template() { }
   explicit Template(const std::string& content): content(content) { }
 
@@ -31,7 +45,22 @@ struct Template {
   }
 };
 
-using TemplateStorage = std::map<std::string, Template>;
+/*!
+ * \brief Templates that can be included by name.
+ *
+ * Templates are not changed once they are parsed, so one copy can be shared by any number of environments and renderers,
+ * including ones on other threads.
+ */
+using TemplateStorage = std::map<std::string, std::shared_ptr<const Template>>;
+
+/// Returns the template named by an include or extends statement, or nullptr if there is none
+inline const Template *find_template(const TemplateStorage &template_storage, const std::string &name, const Template *resolved) {
+  if (resolved) {
+    return resolved;
+  }
+  const auto template_it = template_storage.find(name);
+  return (template_it != template_storage.end()) ? template_it->second.get() : nullptr;
+}
 
 } // namespace inja
 
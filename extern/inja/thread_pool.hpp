@@ -0,0 +1,130 @@
+#ifndef INCLUDE_INJA_THREAD_POOL_HPP_
+#define INCLUDE_INJA_THREAD_POOL_HPP_
+
+#include <algorithm>
+#include <condition_variable>
+#include <exception>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <queue>
+#include <sstream>
+#include <thread>
+#include <vector>
+
+
+namespace inja {
+
+/*!
+ * \brief Worker threads that render the iterations of parallel loops.
+ */
+class ThreadPool {
+  std::vector<std::thread> workers;
+  std::queue<std::function<void()>> tasks;
+  std::mutex mutex;
+  std::condition_variable available;
+  bool stopping {false};
+
+  static bool& is_worker() {
+    thread_local bool worker {false};
+    return worker;
+  }
+
+  void work() {
+    is_worker() = true;
+    for (;;) {
+      std::function<void()> task;
+      {
+        std::unique_lock<std::mutex> lock {mutex};
+        available.wait(lock, [this] { return stopping || !tasks.empty(); });
+        if (tasks.empty()) {
+          return;
+        }
+        task = std::move(tasks.front());
+        tasks.pop();
+      }
+      task();
+    }
+  }
+
+public:
+  explicit ThreadPool(size_t size) {
+    for (size_t i = 0; i < size; ++i) {
+      workers.emplace_back([this] { work(); });
+    }
+  }
+
+  ThreadPool(const ThreadPool&) = delete;
+  ThreadPool& operator=(const ThreadPool&) = delete;
+
+  ~ThreadPool() {
+    {
+      std::lock_guard<std::mutex> lock {mutex};
+      stopping = true;
+    }
+    available.notify_all();
+    for (auto &worker : workers) {
+      worker.join();
+    }
+  }
+
+  static ThreadPool& shared() {
+    static ThreadPool pool {std::max<size_t>(std::thread::hardware_concurrency(), 1)};
+    return pool;
+  }
+
+  size_t size() const {
+    return workers.size();
+  }
+
+  std::future<void> submit(std::function<void()> task) {
+    auto packaged = std::make_shared<std::packaged_task<void()>>(std::move(task));
+    std::future<void> result = packaged->get_future();
+    {
+      std::lock_guard<std::mutex> lock {mutex};
+      tasks.emplace([packaged] { (*packaged)(); });
+    }
+    available.notify_one();
+    return result;
+  }
+
+  /*!
+   * \brief Splits [0, size) into ranges that are rendered concurrently, each into its own buffer, and writes the
+   * buffers to os in order.
+   *
+   * Returns false without rendering anything if there is nothing to split, or when called from a worker, as a
+   * nested parallel loop waiting for the pool it runs on could deadlock. The caller then renders serially.
+   */
+  bool render_in_order(std::ostream &os, size_t size, const std::function<void(std::ostream&, size_t, size_t)> &render) {
+    if (size < 2 || is_worker()) {
+      return false;
+    }
+
+    const size_t chunks = std::min(size, 4 * workers.size());
+    std::vector<std::ostringstream> outputs(chunks);
+    std::vector<std::future<void>> done;
+    done.reserve(chunks);
+    for (size_t i = 0; i < chunks; ++i) {
+      const size_t first = size * i / chunks;
+      const size_t last = size * (i + 1) / chunks;
+      std::ostringstream *output = &outputs[i];
+      done.push_back(submit([&render, output, first, last] { render(*output, first, last); }));
+    }
+
+    // Every chunk has to finish before an error is rethrown, as they refer to the outputs
+    for (auto &chunk : done) {
+      chunk.wait();
+    }
+    for (size_t i = 0; i < chunks; ++i) {
+      done[i].get();
+      os << outputs[i].str();
+    }
+    return true;
+  }
+};
+
+} // namespace inja
+
+#endif // INCLUDE_INJA_THREAD_POOL_HPP_
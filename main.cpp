@@ -1,16 +1,70 @@
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdlib>
+#include <ctime>
+#include <deque>
+#include <exception>
 #include <iostream>
+#include <memory>
+#include <mutex>
 #include <string_view>
 #include <fstream>
+#include <functional>
 #include <string>
 #include <set>
+#include <sstream>
 #include <stack>
 #include <string_view>
+#include <thread>
+#include <unordered_map>
+#include <vector>
 
 #include "nlohmann/json.hpp"
 #include "inja/inja.hpp"
 
+#ifdef JSCHEMA_COMPILED_TEMPLATES
+#include "jschema_templates.h"
+#endif
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <sys/resource.h>
+#endif
+
 namespace nl = nlohmann;
 
+#ifdef JSCHEMA_COUNT_ALLOCATIONS
+// Every allocation is counted for --profile
+namespace jschema {
+std::atomic<std::size_t> ALLOCATIONS {0};
+std::atomic<std::size_t> ALLOCATED_BYTES {0};
+}
+
+void *operator new(std::size_t size)
+{
+  jschema::ALLOCATIONS.fetch_add(1, std::memory_order_relaxed);
+  jschema::ALLOCATED_BYTES.fetch_add(size, std::memory_order_relaxed);
+  if (void *p = std::malloc(size ? size : 1)) {
+    return p;
+  }
+  throw std::bad_alloc();
+}
+
+void operator delete(void *p) noexcept
+{
+  std::free(p);
+}
+
+void operator delete(void *p, std::size_t) noexcept
+{
+  std::free(p);
+}
+#endif
+
 namespace jschema {
 
 enum TokenType {
@@ -38,7 +92,7 @@ static std::map<std::string, std::string> FORMAT_TYPES = {
 };
 
 static std::map<TokenType, std::string> CPP_TYPES = {
-  {INTEGER, "int"},
+  {INTEGER, "std::int64_t"},
   {NUMBER,  "double"},
   {BOOLEAN, "bool"},
   {STRING,  "std::string"},
@@ -47,6 +101,26 @@ static std::map<TokenType, std::string> CPP_TYPES = {
 
 static std::string OPTIONAL_TYPE = "std::optional";
 
+// Fixed width integers that bounded integers can narrow to, narrowest first
+struct IntegerType
+{
+  std::string name;
+  std::size_t size;
+  std::int64_t min;
+  std::uint64_t max;
+};
+
+static const std::vector<IntegerType> INTEGER_TYPES = {
+  {"std::uint8_t",  1, 0, UINT8_MAX},
+  {"std::int8_t",   1, INT8_MIN, INT8_MAX},
+  {"std::uint16_t", 2, 0, UINT16_MAX},
+  {"std::int16_t",  2, INT16_MIN, INT16_MAX},
+  {"std::uint32_t", 4, 0, UINT32_MAX},
+  {"std::int32_t",  4, INT32_MIN, INT32_MAX},
+  {"std::uint64_t", 8, 0, UINT64_MAX},
+  {"std::int64_t",  8, INT64_MIN, INT64_MAX},
+};
+
 void loadCppTypes()
 {
   std::ifstream inTypes("templates/types.json");
@@ -71,9 +145,10 @@ void loadCppTypes()
 
 // Makes a string conform to Camel Case
 // IE: Remove spaces and underscores and capitalise subsequent words
-std::string camelCase(const std::string &input)
+std::string camelCase(std::string_view input)
 {
   std::string result;
+  result.reserve(input.size());
   bool forceUpper = false;
   for (std::size_t i = 0; i < input.size(); ++i) {
     char c = forceUpper ? std::toupper(input[i]) : input[i];
@@ -90,7 +165,7 @@ std::string camelCase(const std::string &input)
 }
 
 // Camel case with first letter capitalised
-std::string pascalCase(const std::string &input)
+std::string pascalCase(std::string_view input)
 {
   std::string result = camelCase(input);
 
@@ -101,44 +176,363 @@ std::string pascalCase(const std::string &input)
   return result;
 }
 
-struct SchemaParser : nl::json_sax<nl::json>
+// A property or class name from the schema, with the class name derived from it
+struct Name
+{
+  std::string text;
+  std::string pascal;
+};
+
+// Every distinct name is stored once, with its Pascal case computed once. The
+// names stay where they are until the table is destroyed
+class NameTable
+{
+public:
+  const Name &intern(std::string_view text)
+  {
+    auto it = m_names.find(text);
+    if (it == m_names.end()) {
+      auto name = std::make_unique<Name>(Name{std::string(text), pascalCase(text)});
+      it = m_names.emplace(name->text, std::move(name)).first;
+    }
+    return *it->second;
+  }
+
+private:
+  std::unordered_map<std::string_view, std::unique_ptr<Name>> m_names;
+};
+
+// Writes arbitrary bytes as a C++ string literal. A hex escape is always
+// followed by a new literal so that it cannot absorb the next character
+std::string cppStringLiteral(const std::string &bytes)
+{
+  static const char *HEX = "0123456789abcdef";
+  std::string result = "\"";
+  bool afterEscape = false;
+
+  for (unsigned char c : bytes) {
+    bool printable = c >= 0x20 && c < 0x7f;
+    if (printable && afterEscape) {
+      result += "\" \"";
+    }
+
+    afterEscape = !printable;
+    if (c == '"' || c == '\\') {
+      result += '\\';
+      result += c;
+    } else if (printable) {
+      result += c;
+    } else {
+      result += "\\x";
+      result += HEX[c >> 4];
+      result += HEX[c & 0xf];
+    }
+  }
+
+  return result + "\"";
+}
+
+// Appends n as a big endian number of the given width
+void appendBigEndian(std::string &out, std::uint64_t n, int bytes)
+{
+  for (int i = bytes - 1; i >= 0; --i) {
+    out += static_cast<char>((n >> (i * 8)) & 0xff);
+  }
+}
+
+// A string as MessagePack encodes it, with the shortest str header
+std::string msgpackString(const std::string &value)
+{
+  std::string result;
+  std::size_t n = value.size();
+
+  if (n < 32) {
+    result += static_cast<char>(0xa0 | n);
+  } else if (n <= 0xff) {
+    result += static_cast<char>(0xd9);
+    appendBigEndian(result, n, 1);
+  } else if (n <= 0xffff) {
+    result += static_cast<char>(0xda);
+    appendBigEndian(result, n, 2);
+  } else {
+    result += static_cast<char>(0xdb);
+    appendBigEndian(result, n, 4);
+  }
+
+  return result + value;
+}
+
+// A string as CBOR encodes it, with the shortest text string header
+std::string cborString(const std::string &value)
+{
+  const char TEXT = 3 << 5;
+  std::string result;
+  std::size_t n = value.size();
+
+  if (n < 24) {
+    result += static_cast<char>(TEXT | n);
+  } else if (n <= 0xff) {
+    result += static_cast<char>(TEXT | 24);
+    appendBigEndian(result, n, 1);
+  } else if (n <= 0xffff) {
+    result += static_cast<char>(TEXT | 25);
+    appendBigEndian(result, n, 2);
+  } else {
+    result += static_cast<char>(TEXT | 26);
+    appendBigEndian(result, n, 4);
+  }
+
+  return result + value;
+}
+
+// Whether an integer schema bound lies within [min, max]
+bool boundWithin(const nl::json &bound, std::int64_t min, std::uint64_t max)
+{
+  if (bound.is_number_unsigned()) {
+    return bound.get<std::uint64_t>() <= max;
+  }
+
+  std::int64_t value = bound.get<std::int64_t>();
+  return value >= min && (value < 0 || static_cast<std::uint64_t>(value) <= max);
+}
+
+// Whether an integer variable's default lies within its minimum and maximum
+bool defaultWithin(const nl::json &props)
+{
+  const nl::json &value = props["default"];
+  if (!value.is_number()) {
+    return true;
+  }
+
+  // Bounds are integers once rounded, compared to a default in its own type
+  auto below = [](const nl::json &a, const nl::json &b) {
+    if (a.is_number_float() || b.is_number_float()) {
+      return a.get<double>() < b.get<double>();
+    } else if (a.is_number_unsigned() && b.is_number_unsigned()) {
+      return a.get<std::uint64_t>() < b.get<std::uint64_t>();
+    } else if (a.is_number_unsigned()) {
+      return b.get<std::int64_t>() >= 0 && a.get<std::uint64_t>() < b.get<std::uint64_t>();
+    } else if (b.is_number_unsigned()) {
+      return a.get<std::int64_t>() < 0 || a.get<std::uint64_t>() < b.get<std::uint64_t>();
+    }
+    return a.get<std::int64_t>() < b.get<std::int64_t>();
+  };
+
+  return !(props.count("minimum") && below(value, props["minimum"])) &&
+         !(props.count("maximum") && below(props["maximum"], value));
+}
+
+// Picks the narrowest integer type that holds the declared minimum and
+// maximum of an integer variable, and its default wherever that lies. With
+// only a minimum that is not negative the type is unsigned, otherwise
+// unbounded integers are 64 bit unless the default needs them unsigned
+std::string integerType(const nl::json &props)
+{
+  bool hasMinimum = props.count("minimum");
+  bool hasMaximum = props.count("maximum");
+  bool hasDefault = props.count("default") && props["default"].is_number_integer();
+
+  auto holds = [&](std::int64_t min, std::uint64_t max) {
+    return !hasDefault || boundWithin(props["default"], min, max);
+  };
+
+  if (hasMinimum && hasMaximum) {
+    for (const auto &type : INTEGER_TYPES) {
+      if (boundWithin(props["minimum"], type.min, type.max) && boundWithin(props["maximum"], type.min, type.max) &&
+          holds(type.min, type.max)) {
+        return type.name;
+      }
+    }
+  }
+
+  bool unsignedMinimum = hasMinimum && boundWithin(props["minimum"], 0, UINT64_MAX);
+  if ((unsignedMinimum && holds(0, UINT64_MAX)) || !holds(INT64_MIN, INT64_MAX)) {
+    return "std::uint64_t";
+  }
+
+  return CPP_TYPES.at(INTEGER);
+}
+
+// The condition under which a decoded value v lies outside a variable's
+// declared minimum and maximum, or an empty string when there is nothing
+// to check. Bounds that the narrowed integer type already enforces are
+// left out
+std::string rangeCheck(const nl::json &props)
+{
+  const IntegerType *integer = nullptr;
+  if (props["type"] == "integer") {
+    std::string name = integerType(props);
+    for (const auto &type : INTEGER_TYPES) {
+      if (type.name == name) {
+        integer = &type;
+      }
+    }
+  }
+
+  std::string condition;
+  if (props.count("minimum")) {
+    const nl::json &bound = props["minimum"];
+    bool enforced = integer && (bound.is_number_unsigned() ? integer->min == 0 && bound.get<std::uint64_t>() == 0
+                                                           : bound.get<std::int64_t>() == integer->min);
+    if (!enforced) {
+      condition = "v < " + bound.dump();
+    }
+  }
+
+  if (props.count("maximum")) {
+    const nl::json &bound = props["maximum"];
+    bool enforced = integer && bound.is_number_unsigned() && bound.get<std::uint64_t>() == integer->max;
+    if (!enforced) {
+      condition += (condition.empty() ? "v > " : " || v > ") + bound.dump();
+    }
+  }
+
+  return condition;
+}
+
+// What SchemaParser::key() does with the value of a JSON Schema keyword
+enum KeywordHandler : std::uint8_t {
+  // Not interpreted yet. Like any other key, the keyword names the property that follows
+  KEY_NAME,
+  // Skipped with a warning
+  KEY_UNSUPPORTED,
+  KEY_PROPERTIES,
+  KEY_TYPE,
+  KEY_DEFAULT,
+  KEY_REFERENCE,
+  KEY_ENUM,
+  KEY_ITEMS,
+  KEY_REQUIRED,
+  KEY_FORMAT,
+  KEY_MINIMUM,
+  KEY_MAXIMUM,
+};
+
+struct Keyword
+{
+  std::string_view name;
+  KeywordHandler handler;
+};
+
+// The draft-07 and 2020-12 vocabularies
+constexpr Keyword KEYWORDS[] = {
+  {"$schema", KEY_UNSUPPORTED}, {"$id", KEY_UNSUPPORTED}, {"$ref", KEY_REFERENCE}, {"$comment", KEY_NAME},
+  {"$defs", KEY_NAME}, {"$anchor", KEY_NAME}, {"$dynamicRef", KEY_NAME}, {"$dynamicAnchor", KEY_NAME},
+  {"$vocabulary", KEY_NAME},
+  {"title", KEY_UNSUPPORTED}, {"description", KEY_UNSUPPORTED}, {"default", KEY_DEFAULT},
+  {"deprecated", KEY_NAME}, {"readOnly", KEY_NAME}, {"writeOnly", KEY_NAME}, {"examples", KEY_NAME},
+  {"type", KEY_TYPE}, {"enum", KEY_ENUM}, {"const", KEY_UNSUPPORTED},
+  {"multipleOf", KEY_NAME}, {"maximum", KEY_MAXIMUM}, {"exclusiveMaximum", KEY_NAME}, {"minimum", KEY_MINIMUM},
+  {"exclusiveMinimum", KEY_NAME},
+  {"maxLength", KEY_NAME}, {"minLength", KEY_NAME}, {"pattern", KEY_NAME}, {"format", KEY_FORMAT},
+  {"contentEncoding", KEY_NAME}, {"contentMediaType", KEY_NAME}, {"contentSchema", KEY_NAME},
+  {"items", KEY_ITEMS}, {"prefixItems", KEY_NAME}, {"additionalItems", KEY_NAME},
+  {"unevaluatedItems", KEY_NAME}, {"contains", KEY_NAME}, {"maxContains", KEY_NAME}, {"minContains", KEY_NAME},
+  {"maxItems", KEY_UNSUPPORTED}, {"minItems", KEY_UNSUPPORTED}, {"uniqueItems", KEY_UNSUPPORTED},
+  {"properties", KEY_PROPERTIES}, {"patternProperties", KEY_NAME}, {"additionalProperties", KEY_NAME},
+  {"unevaluatedProperties", KEY_NAME}, {"propertyNames", KEY_NAME}, {"maxProperties", KEY_NAME},
+  {"minProperties", KEY_NAME}, {"required", KEY_REQUIRED}, {"dependentRequired", KEY_NAME},
+  {"dependentSchemas", KEY_NAME}, {"dependencies", KEY_NAME}, {"definitions", KEY_NAME},
+  {"allOf", KEY_NAME}, {"anyOf", KEY_NAME}, {"oneOf", KEY_NAME}, {"not", KEY_NAME}, {"if", KEY_NAME},
+  {"then", KEY_NAME}, {"else", KEY_NAME},
+};
+
+constexpr std::size_t KEYWORD_TABLE_BITS = 10;
+
+constexpr std::uint32_t keywordHash(std::string_view text, std::uint32_t seed)
+{
+  std::uint32_t hash = 2166136261u ^ seed;
+  for (char c : text) {
+    hash = (hash ^ static_cast<unsigned char>(c)) * 16777619u;
+  }
+  return hash >> (32 - KEYWORD_TABLE_BITS);
+}
+
+// Perfect hash of KEYWORDS: every keyword has its own slot, which holds its index plus one
+struct KeywordTable
+{
+  std::uint32_t seed;
+  std::array<std::uint8_t, 1 << KEYWORD_TABLE_BITS> slots;
+};
+
+// Tries seeds until one hashes every keyword to a different slot
+constexpr KeywordTable buildKeywordTable()
+{
+  for (std::uint32_t seed = 0;; ++seed) {
+    KeywordTable table {seed, {}};
+    bool perfect = true;
+    for (std::size_t i = 0; perfect && i < std::size(KEYWORDS); ++i) {
+      std::uint8_t &slot = table.slots[keywordHash(KEYWORDS[i].name, seed)];
+      perfect = slot == 0;
+      slot = static_cast<std::uint8_t>(i + 1);
+    }
+    if (perfect) {
+      return table;
+    }
+  }
+}
+
+constexpr KeywordTable KEYWORD_TABLE = buildKeywordTable();
+
+// Keys that are not keywords name properties
+constexpr KeywordHandler keywordHandler(std::string_view key)
+{
+  const std::uint8_t slot = KEYWORD_TABLE.slots[keywordHash(key, KEYWORD_TABLE.seed)];
+  return (slot != 0 && KEYWORDS[slot - 1].name == key) ? KEYWORDS[slot - 1].handler : KEY_NAME;
+}
+
+static_assert(keywordHandler("properties") == KEY_PROPERTIES && keywordHandler("name") == KEY_NAME, "keyword table");
+
+// Parses a schema with nl::json::sax_parse and passes what it finds on to
+// Backend, which derives from it
+template <typename Backend>
+struct SchemaParser
 {
   SchemaParser(const std::string &baseClassName = "Base")
-    : m_currentVariable(baseClassName)
+    : m_currentVariable(&m_names.intern(baseClassName))
   {
     m_isPropertiesStack.push(false);
     m_isArrayItemsStack.push(false);
     m_objectNameStack.push(baseClassName);
   }
 
-  virtual ~SchemaParser()
+  ~SchemaParser()
   {
   }
 
-  // We've begun to encounter some object properties
-  virtual void begin_object_properties(std::string name) = 0;
-  virtual void object_property_required(std::string property) = 0;
-  virtual void object_property_number(std::string name) = 0;
-  virtual void object_default_number(std::string variable, double number) = 0;
-  virtual void object_property_int(std::string name) = 0;
-  virtual void object_default_int(std::string variable, int number) = 0;
-  virtual void object_property_string(std::string name) = 0;
-  virtual void object_default_string(std::string variable, std::string string) = 0;
-  virtual void object_property_boolean(std::string name) = 0;
-  virtual void object_default_boolean(std::string variable, bool boolean) = 0;
-  virtual void object_property_ref(std::string name, std::string target) = 0;
-  virtual void object_property_enum_element(std::string variable, std::string name) = 0;
-  virtual void object_property_format(std::string variable, std::string format) = 0;
-  virtual void object_property_array(std::string name) = 0;
-  virtual void end_object_properties() = 0;
+  // Types used by nl::json::sax_parse
+  using number_integer_t = nl::json::number_integer_t;
+  using number_unsigned_t = nl::json::number_unsigned_t;
+  using number_float_t = nl::json::number_float_t;
+  using string_t = nl::json::string_t;
+  using binary_t = nl::json::binary_t;
+
+  // The backend receives the schema through these members, which it
+  // defines as it sees fit. Property names are passed as const Name &, which
+  // stay valid for as long as the parser, and other strings as
+  // std::string_view:
+  //   begin_object_properties(className), end_object_properties(), which
+  //     returns false if the object is invalid
+  //   object_property_required(property)
+  //   object_property_number/int/string/boolean/array(name)
+  //   object_default_number/int/string/boolean(variable, value)
+  //   object_property_minimum/maximum(variable, bound), bounds are passed
+  //     as parsed so that 64 bit integers stay exact
+  //   object_property_ref(name, target)
+  //   object_property_enum_element(variable, value)
+  //   object_property_format(variable, format)
+  Backend &backend()
+  {
+    return static_cast<Backend &>(*this);
+  }
 
-  bool null() override
+  bool null()
   {
     std::cerr << "null";
     return false;
   }
 
-  bool binary(binary_t &val) override
+  bool binary(binary_t &val)
   {
     std::cerr << "binary";
     return false;
@@ -148,7 +542,7 @@ struct SchemaParser : nl::json_sax<nl::json>
   bool boolean(bool val)
   {
     if (m_unsupported) {
-      std::cout << "WARNING: Skipping unsupported tag " << m_currentVariable << ", value: " << val << std::endl;
+      std::cout << "WARNING: Skipping unsupported tag " << m_currentVariable->text << ", value: " << val << std::endl;
       return true;
     } 
 
@@ -157,7 +551,7 @@ struct SchemaParser : nl::json_sax<nl::json>
         return false;
       }
       
-      object_default_boolean(m_currentVariable, val);
+      backend().object_default_boolean(*m_currentVariable, val);
       return true;
     }
 
@@ -166,11 +560,27 @@ struct SchemaParser : nl::json_sax<nl::json>
     return false;
   }
 
-  // called when a signed or unsigned integer number is parsed; value is passed
+  // called when a signed integer number is parsed; value is passed
   bool number_integer(number_integer_t val)
+  {
+    return integer(val);
+  }
+
+  // called when an unsigned integer number is parsed; value is passed
+  bool number_unsigned(number_unsigned_t val)
+  {
+    return integer(val);
+  }
+
+  template <typename T>
+  bool integer(T val)
   {
     if (m_unsupported) {
-      std::cout << "WARNING: Skipping unsupported tag " << m_currentVariable << ", value: " << val << std::endl;
+      std::cout << "WARNING: Skipping unsupported tag " << m_currentVariable->text << ", value: " << val << std::endl;
+      return true;
+    }
+
+    if (bound(val)) {
       return true;
     }
 
@@ -179,7 +589,7 @@ struct SchemaParser : nl::json_sax<nl::json>
         return false;
       }
       
-      object_default_int(m_currentVariable, val);
+      backend().object_default_int(*m_currentVariable, val);
       return true;
     }
 
@@ -188,16 +598,15 @@ struct SchemaParser : nl::json_sax<nl::json>
     return false;
   }
 
-  bool number_unsigned(number_unsigned_t val)
-  {
-    return number_integer(val);
-  }
-
   // called when a floating-point number is parsed; value and original string is passed
   bool number_float(number_float_t val, const string_t& s)
   {
     if (m_unsupported) {
-      std::cout << "WARNING: Skipping unsupported tag " << m_currentVariable << ", value: " << val << std::endl;
+      std::cout << "WARNING: Skipping unsupported tag " << m_currentVariable->text << ", value: " << val << std::endl;
+      return true;
+    }
+
+    if (bound(val)) {
       return true;
     }
 
@@ -206,7 +615,7 @@ struct SchemaParser : nl::json_sax<nl::json>
         return false;
       }
       
-      object_default_number(m_currentVariable, val);
+      backend().object_default_number(*m_currentVariable, val);
       return true;
     }
 
@@ -215,6 +624,22 @@ struct SchemaParser : nl::json_sax<nl::json>
     return false;
   }
 
+  // Records the value of a "minimum" or "maximum" key
+  bool bound(const nl::json &val)
+  {
+    if (m_minimum) {
+      backend().object_property_minimum(*m_currentVariable, val);
+      return true;
+    }
+
+    if (m_maximum) {
+      backend().object_property_maximum(*m_currentVariable, val);
+      return true;
+    }
+
+    return false;
+  }
+
   bool is_type_consistent(TokenType tp)
   {
     bool consistent = m_typeStack.top() == UNKNOWN ||
@@ -233,14 +658,14 @@ struct SchemaParser : nl::json_sax<nl::json>
   bool string(string_t& val)
   {
     if (m_unsupported) {
-      std::cout << "WARNING: Skipping unsupported tag " << m_currentVariable << ", value: " << val << std::endl;
+      std::cout << "WARNING: Skipping unsupported tag " << m_currentVariable->text << ", value: " << val << std::endl;
       return true;
     }
 
     if (m_ref) {
       // The last part of the reference key will be the target
       std::size_t lastSlash = val.find_last_of('/');
-      object_property_ref(m_currentVariable, pascalCase(val.substr(lastSlash + 1)));
+      backend().object_property_ref(*m_currentVariable, m_names.intern(std::string_view(val).substr(lastSlash + 1)).pascal);
       return true;
     }
 
@@ -251,18 +676,18 @@ struct SchemaParser : nl::json_sax<nl::json>
       }
 
       // If we encounter an enum then the type must be string
-      object_property_enum_element(m_currentVariable, val);
+      backend().object_property_enum_element(*m_currentVariable, val);
       m_typeStack.top() = STRING;
       return true;
     }
 
     if (m_required) {
-      object_property_required(val);
+      backend().object_property_required(m_names.intern(val));
       return true;
     }
 
     if (m_format) {
-      object_property_format(m_currentVariable, val);
+      backend().object_property_format(*m_currentVariable, val);
       return true;
     }
 
@@ -286,24 +711,24 @@ struct SchemaParser : nl::json_sax<nl::json>
 
       switch (tp) {
         case INTEGER: 
-          object_property_int(m_currentVariable);
+          backend().object_property_int(*m_currentVariable);
           break;
         case NUMBER:
-          object_property_number(m_currentVariable);
+          backend().object_property_number(*m_currentVariable);
           break;
         case BOOLEAN:
-          object_property_boolean(m_currentVariable);
+          backend().object_property_boolean(*m_currentVariable);
           break;
         case STRING:
-          object_property_string(m_currentVariable);
+          backend().object_property_string(*m_currentVariable);
           break;
         case OBJECT:
           if (m_isPropertiesStack.size() > 2) {
-            object_property_ref(m_currentVariable, pascalCase(m_currentVariable));
+            backend().object_property_ref(*m_currentVariable, m_currentVariable->pascal);
           }
           break;
         case ARRAY:
-          object_property_array(m_currentVariable);
+          backend().object_property_array(*m_currentVariable);
           break;
       }
 
@@ -316,7 +741,7 @@ struct SchemaParser : nl::json_sax<nl::json>
         return false;
       }
 
-      object_default_string(m_currentVariable, val);
+      backend().object_default_string(*m_currentVariable, val);
       return true;
     }
 
@@ -332,7 +757,7 @@ struct SchemaParser : nl::json_sax<nl::json>
     m_isArrayItemsStack.push(m_isArrayItems);
 
     if (m_isPropertiesStack.top()) {
-      begin_object_properties(pascalCase(m_currentVariable));
+      backend().begin_object_properties(m_currentVariable->pascal);
     }
 
     m_isPropertiesStack.push(false);
@@ -345,8 +770,8 @@ struct SchemaParser : nl::json_sax<nl::json>
     m_typeStack.pop();
     m_isArrayItemsStack.pop();
 
-    if (m_isPropertiesStack.top()) {
-      end_object_properties();
+    if (m_isPropertiesStack.top() && !backend().end_object_properties()) {
+      return false;
     }
 
     m_isPropertiesStack.pop();
@@ -379,63 +804,52 @@ struct SchemaParser : nl::json_sax<nl::json>
     m_unsupported = false;
     m_isArrayItems = false;
     m_format = false;
+    m_minimum = false;
+    m_maximum = false;
 
     std::cout << val << std::endl;
 
-    if (UNSUPPORTED_TOKENS.count(val)) {
-      m_unsupported = true;
-      return true;
-    }
-
-    if (!NON_TOKEN_ATTRIBUTES.count(val)) {
-      m_currentVariable = val;
-      return true;
-    }
-
-    if (val == PROPERTIES_KEY) {
-      m_isPropertiesStack.top() = true;
-      return true;
-    }
-
-    if (val == ARRAY_ITEMS_KEY) {
-      m_isArrayItemsStack.top() = true;
-      m_isArrayItems = true;
-      return true;
-    }
-
-    if (val == REFERENCE_KEY) {
-      m_ref = true;
-      return true;
-    }
-
-    if (val == TYPE_KEY) {
-      m_type = true;
-      return true;
-    }
-
-    if (val == DEFAULT_KEY) {
-      m_default = true;
-      return true;
+    switch (keywordHandler(val)) {
+      case KEY_NAME:
+        m_currentVariable = &m_names.intern(val);
+        break;
+      case KEY_UNSUPPORTED:
+        m_unsupported = true;
+        break;
+      case KEY_PROPERTIES:
+        m_isPropertiesStack.top() = true;
+        break;
+      case KEY_ITEMS:
+        m_isArrayItemsStack.top() = true;
+        m_isArrayItems = true;
+        break;
+      case KEY_REFERENCE:
+        m_ref = true;
+        break;
+      case KEY_TYPE:
+        m_type = true;
+        break;
+      case KEY_DEFAULT:
+        m_default = true;
+        break;
+      case KEY_ENUM:
+        m_enum = true;
+        break;
+      case KEY_REQUIRED:
+        m_required = true;
+        break;
+      case KEY_FORMAT:
+        m_format = true;
+        break;
+      case KEY_MINIMUM:
+        m_minimum = true;
+        break;
+      case KEY_MAXIMUM:
+        m_maximum = true;
+        break;
     }
 
-    if (val == ENUM_KEY) {
-      m_enum = true;
-      return true;
-    }
-
-    if (val == REQUIRED_KEY) {
-      m_required = true;
-      return true;
-    }
-
-    if (val == FORMAT_KEY) {
-      m_format = true;
-      return true;
-    }
-
-    std::cerr << "Bad Key: " << val;
-
-    return false;
+    return true;
   }
 
   // called when a parse error occurs; byte position, the last token, and an exception is passed
@@ -446,8 +860,10 @@ struct SchemaParser : nl::json_sax<nl::json>
   }
 
 private:
-  // String representing the name of the last token key that was processed
-  std::string m_currentVariable;
+  NameTable m_names;
+
+  // The name of the last token key that was processed
+  const Name *m_currentVariable;
   std::string m_currentObject;
 
   std::stack<std::string> m_objectNameStack;
@@ -461,30 +877,19 @@ private:
   bool m_isArrayItems = false;
   bool m_required = false;
   bool m_format = false;
+  bool m_minimum = false;
+  bool m_maximum = false;
 
   std::stack<TokenType> m_typeStack;
 
   // Whether the current object represents properties
   std::stack<bool> m_isPropertiesStack;
   std::stack<bool> m_isArrayItemsStack;
-
-  // Attributes that, when encountered, are not used for class naming
-  const std::string PROPERTIES_KEY = "properties";
-  const std::string TYPE_KEY = "type";
-  const std::string DEFAULT_KEY = "default";
-  const std::string REFERENCE_KEY = "$ref";
-  const std::string ENUM_KEY = "enum";
-  const std::string ARRAY_ITEMS_KEY = "items";
-  const std::string REQUIRED_KEY = "required";
-  const std::string FORMAT_KEY = "format";
-
-  // List of attributes that are treated as non-tokens, IE: Not used as names
-  const std::set<std::string> NON_TOKEN_ATTRIBUTES = {PROPERTIES_KEY, TYPE_KEY, DEFAULT_KEY, REFERENCE_KEY, REQUIRED_KEY, FORMAT_KEY, "items", "enum"};
-  const std::set<std::string> UNSUPPORTED_TOKENS = {"$schema", "$id", "title", "description", "minimum", "maximum", "const", "minItems", "maxItems", "uniqueItems"};
 };
 
-struct SchemaTemplateParser : SchemaParser
+struct SchemaTemplateParser : SchemaParser<SchemaTemplateParser>
 {
+  friend struct SchemaParser<SchemaTemplateParser>;
 
   SchemaTemplateParser(const std::string &baseClassName)
     : SchemaParser(baseClassName)
@@ -493,24 +898,27 @@ struct SchemaTemplateParser : SchemaParser
     output["enums"] = {};
   }
 
-  virtual ~SchemaTemplateParser()
+  ~SchemaTemplateParser()
   {
 
   }
 
   nl::json output;
 
+  // Receives every object once its properties end, in place of output["objects"]
+  std::function<void(nl::json &object)> emitObject;
+
   protected:
     std::stack<nl::json> m_stack;
 
-    void begin_object_properties(std::string name) override
+    void begin_object_properties(std::string_view className)
     {
       nl::json current;
 
-      current["className"] = name;
+      current["className"] = std::string(className);
       current["variables"] = {};
 
-      m_stack.push(current);
+      m_stack.push(std::move(current));
     }
 
     nl::json &getCurrent()
@@ -518,106 +926,836 @@ struct SchemaTemplateParser : SchemaParser
       return m_stack.top();
     }
 
-    void object_property_number(std::string name) override
+    void object_property_number(const Name &name)
     {
-      getCurrent()["variables"][name]["type"] = "number";
+      getCurrent()["variables"][name.text]["type"] = "number";
     }
 
-    void object_default_number(std::string name, double number) override
+    void object_default_number(const Name &name, double number)
     {
-      getCurrent()["variables"][name]["default"] = number;
+      getCurrent()["variables"][name.text]["default"] = number;
     }
 
-    void object_property_int(std::string name) override
+    void object_property_int(const Name &name)
     {
-      getCurrent()["variables"][name]["type"] = "integer";
+      getCurrent()["variables"][name.text]["type"] = "integer";
     }
 
-    void object_default_int(std::string name, int number) override
+    void object_default_int(const Name &name, std::int64_t number)
     {
-      getCurrent()["variables"][name]["default"] = number;
+      getCurrent()["variables"][name.text]["default"] = number;
     }
 
-    void object_property_string(std::string name) override
+    void object_default_int(const Name &name, std::uint64_t number)
     {
-      getCurrent()["variables"][name]["type"] = "string";
+      getCurrent()["variables"][name.text]["default"] = number;
     }
 
-    void object_default_string(std::string name, std::string string) override
+    void object_property_minimum(const Name &name, const nl::json &bound)
     {
-      getCurrent()["variables"][name]["default"] = string;
+      getCurrent()["variables"][name.text]["minimum"] = bound;
     }
 
-    void object_property_boolean(std::string name) override
+    void object_property_maximum(const Name &name, const nl::json &bound)
     {
-      getCurrent()["variables"][name]["type"] = "boolean";
+      getCurrent()["variables"][name.text]["maximum"] = bound;
     }
 
-    void object_default_boolean(std::string name, bool boolean) override
+    void object_property_string(const Name &name)
     {
-      getCurrent()["variables"][name]["default"] = boolean;
+      getCurrent()["variables"][name.text]["type"] = "string";
     }
 
-    void object_property_ref(std::string name, std::string target) override
+    void object_default_string(const Name &name, std::string_view string)
     {
-      getCurrent()["variables"][name]["type"] = "reference";
-      getCurrent()["variables"][name]["className"] = target;
+      getCurrent()["variables"][name.text]["default"] = std::string(string);
     }
 
-    void object_property_array(std::string name) override
+    void object_property_boolean(const Name &name)
     {
-      getCurrent()["variables"][name]["isArray"] = true;
+      getCurrent()["variables"][name.text]["type"] = "boolean";
     }
 
-    void object_property_enum_element(std::string variable, std::string name) override
+    void object_default_boolean(const Name &name, bool boolean)
     {
-      object_property_ref(variable, pascalCase(variable));
-      output["enums"][pascalCase(variable)].push_back(name);
+      getCurrent()["variables"][name.text]["default"] = boolean;
     }
 
-    void object_property_required(std::string variable) override
+    void object_property_ref(const Name &name, std::string_view target)
     {
-      getCurrent()["variables"][variable]["isRequired"] = true;
+      getCurrent()["variables"][name.text]["type"] = "reference";
+      getCurrent()["variables"][name.text]["className"] = std::string(target);
     }
 
-    void object_property_format(std::string variable, std::string format)
+    void object_property_array(const Name &name)
     {
-      getCurrent()["variables"][variable]["type"] = format;
+      getCurrent()["variables"][name.text]["isArray"] = true;
     }
 
-    void end_object_properties() override
+    void object_property_enum_element(const Name &variable, std::string_view value)
     {
+      object_property_ref(variable, variable.pascal);
+      output["enums"][variable.pascal].push_back(std::string(value));
+    }
+
+    void object_property_required(const Name &variable)
+    {
+      getCurrent()["variables"][variable.text]["isRequired"] = true;
+    }
+
+    void object_property_format(const Name &variable, std::string_view format)
+    {
+      getCurrent()["variables"][variable.text]["type"] = std::string(format);
+    }
+
+    bool end_object_properties()
+    {
+      // Fractional bounds of integers are rounded inwards, bounds beyond
+      // 64 bits are dropped as the type already enforces them. A default
+      // outside the bounds would fail the range check of every decoded
+      // value that leaves it out, so it is an error
+      for (auto &variable : getCurrent()["variables"].items()) {
+        nl::json &props = variable.value();
+        if (props["type"] != "integer") {
+          continue;
+        }
+
+        for (const std::string key : {"minimum", "maximum"}) {
+          if (!props.count(key) || !props[key].is_number_float()) {
+            continue;
+          }
+
+          double bound = props[key];
+          bound = key == "minimum" ? std::ceil(bound) : std::floor(bound);
+          if (bound >= -9223372036854775808.0 && bound < 0) {
+            props[key] = static_cast<std::int64_t>(bound);
+          } else if (bound >= 0 && bound < 18446744073709551616.0) {
+            props[key] = static_cast<std::uint64_t>(bound);
+          } else {
+            props.erase(key);
+          }
+        }
+
+        if (props.count("default") && !defaultWithin(props)) {
+          std::cerr << "Default of " << variable.key() << " lies outside its minimum and maximum" << std::endl;
+          return false;
+        }
+      }
+
       std::cout << "end object" << std::endl;
-      output["objects"].push_back(getCurrent());
+      if (emitObject) {
+        emitObject(getCurrent());
+      } else {
+        output["objects"].push_back(std::move(getCurrent()));
+      }
       m_stack.pop();
+      return true;
+    }
+
+};
+
+// Time spent in every phase of a run, with the counts of what was parsed and
+// generated, as reported by --profile. CPU time is that of the whole process,
+// which includes the workers of parallel loops. The phases of --stream run at
+// the same time, so that their times overlap
+class Profile
+{
+public:
+  enum Phase { SAX_PARSE, IR_BUILD, TEMPLATE_PARSE, RENDER, OUTPUT_WRITE, PHASE_COUNT };
+
+  enum Event {
+    NULL_VALUE, BOOLEAN, NUMBER_INTEGER, NUMBER_UNSIGNED, NUMBER_FLOAT, STRING, BINARY,
+    START_OBJECT, END_OBJECT, START_ARRAY, END_ARRAY, KEY, EVENT_COUNT
+  };
+
+  // Adds the time from its construction to its destruction to a phase
+  class Timer
+  {
+  public:
+    Timer(Profile &profile, Phase phase)
+      : m_profile(profile), m_phase(phase), m_wall(std::chrono::steady_clock::now()), m_cpu(std::clock())
+    {
+    }
+
+    Timer(const Timer &) = delete;
+    Timer &operator=(const Timer &) = delete;
+
+    ~Timer()
+    {
+      auto wall = std::chrono::steady_clock::now() - m_wall;
+      m_profile.m_wall[m_phase] += std::chrono::duration_cast<std::chrono::nanoseconds>(wall).count();
+      m_profile.m_cpu[m_phase] += (std::clock() - m_cpu) * (1000000000 / CLOCKS_PER_SEC);
+    }
+
+  private:
+    Profile &m_profile;
+    Phase m_phase;
+    std::chrono::steady_clock::time_point m_wall;
+    std::clock_t m_cpu;
+  };
+
+  std::array<std::size_t, EVENT_COUNT> events {};
+  std::size_t objects = 0;
+  std::size_t enums = 0;
+  std::size_t aliases = 0;
+  std::size_t properties = 0;
+
+  // Counts the objects, enums, aliases and properties of a complete IR
+  void count(const nl::json &output)
+  {
+    objects = output["objects"].size();
+    enums = output["enums"].size();
+    aliases = output.count("aliases") ? output["aliases"].size() : 0;
+    for (const auto &object : output["objects"]) {
+      properties += object["variables"].size();
+    }
+  }
+
+  void print(std::ostream &out, bool asJson) const
+  {
+    static const char *PHASES[] = {"sax parse", "ir build", "template parse", "render", "output write"};
+    static const char *EVENTS[] = {
+      "null", "boolean", "number_integer", "number_unsigned", "number_float", "string", "binary",
+      "start_object", "end_object", "start_array", "end_array", "key"
+    };
+
+    nl::json report;
+    for (int phase = 0; phase < PHASE_COUNT; ++phase) {
+      report["phases"][PHASES[phase]] = {{"wall_ms", m_wall[phase] / 1e6}, {"cpu_ms", m_cpu[phase] / 1e6}};
+    }
+    report["total"] = {{"wall_ms", std::chrono::duration_cast<std::chrono::nanoseconds>(
+                          std::chrono::steady_clock::now() - m_start).count() / 1e6}};
+    report["peak_rss_kb"] = peakRss();
+#ifdef JSCHEMA_COUNT_ALLOCATIONS
+    report["allocations"] = {{"count", ALLOCATIONS.load()}, {"bytes", ALLOCATED_BYTES.load()}};
+#else
+    report["allocations"] = nullptr;
+#endif
+    for (int event = 0; event < EVENT_COUNT; ++event) {
+      report["sax_events"][EVENTS[event]] = events[event];
+    }
+    report["emitted"] = {{"objects", objects}, {"enums", enums}, {"aliases", aliases}, {"properties", properties}};
+
+    if (asJson) {
+      out << report.dump(2) << std::endl;
+      return;
+    }
+
+    auto row = [&out](const std::string &name, const std::string &value) {
+      out << "  " << name << std::string(name.size() < 18 ? 18 - name.size() : 1, ' ') << value << "\n";
+    };
+    auto ms = [](double value) {
+      std::ostringstream text;
+      text.setf(std::ios::fixed);
+      text.precision(3);
+      text << value << " ms";
+      return text.str();
+    };
+
+    out << "phase               wall            cpu\n";
+    for (int phase = 0; phase < PHASE_COUNT; ++phase) {
+      const std::string wall = ms(m_wall[phase] / 1e6);
+      row(PHASES[phase], wall + std::string(wall.size() < 16 ? 16 - wall.size() : 1, ' ') + ms(m_cpu[phase] / 1e6));
+    }
+    row("total", ms(report["total"]["wall_ms"].get<double>()));
+    out << "memory\n";
+    row("peak rss", std::to_string(peakRss()) + " KB");
+#ifdef JSCHEMA_COUNT_ALLOCATIONS
+    row("allocations", std::to_string(ALLOCATIONS.load()) + ", " + std::to_string(ALLOCATED_BYTES.load()) + " bytes");
+#else
+    row("allocations", "not counted, build with -DJSCHEMA_COUNT_ALLOCATIONS");
+#endif
+    out << "sax events\n";
+    for (int event = 0; event < EVENT_COUNT; ++event) {
+      row(EVENTS[event], std::to_string(events[event]));
+    }
+    out << "emitted\n";
+    row("objects", std::to_string(objects));
+    row("enums", std::to_string(enums));
+    row("aliases", std::to_string(aliases));
+    row("properties", std::to_string(properties));
+    out.flush();
+  }
+
+private:
+  static long peakRss()
+  {
+#if defined(__unix__) || defined(__APPLE__)
+    rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+#ifdef __APPLE__
+    return usage.ru_maxrss / 1024;
+#else
+    return usage.ru_maxrss;
+#endif
+#else
+    return 0;
+#endif
+  }
+
+  const std::chrono::steady_clock::time_point m_start = std::chrono::steady_clock::now();
+  std::array<std::atomic<std::int64_t>, PHASE_COUNT> m_wall {};
+  std::array<std::atomic<std::int64_t>, PHASE_COUNT> m_cpu {};
+};
+
+static Profile PROFILE;
+
+// Passes the events of nl::json::sax_parse on to a parser, counting them by kind
+template <typename Parser>
+struct CountingSax
+{
+  Parser &parser;
+  std::array<std::size_t, Profile::EVENT_COUNT> &events;
+
+  using number_integer_t = nl::json::number_integer_t;
+  using number_unsigned_t = nl::json::number_unsigned_t;
+  using number_float_t = nl::json::number_float_t;
+  using string_t = nl::json::string_t;
+  using binary_t = nl::json::binary_t;
+
+  bool null() { ++events[Profile::NULL_VALUE]; return parser.null(); }
+  bool boolean(bool val) { ++events[Profile::BOOLEAN]; return parser.boolean(val); }
+  bool number_integer(number_integer_t val) { ++events[Profile::NUMBER_INTEGER]; return parser.number_integer(val); }
+  bool number_unsigned(number_unsigned_t val) { ++events[Profile::NUMBER_UNSIGNED]; return parser.number_unsigned(val); }
+  bool number_float(number_float_t val, const string_t &s) { ++events[Profile::NUMBER_FLOAT]; return parser.number_float(val, s); }
+  bool string(string_t &val) { ++events[Profile::STRING]; return parser.string(val); }
+  bool binary(binary_t &val) { ++events[Profile::BINARY]; return parser.binary(val); }
+  bool start_object(std::size_t elements) { ++events[Profile::START_OBJECT]; return parser.start_object(elements); }
+  bool end_object() { ++events[Profile::END_OBJECT]; return parser.end_object(); }
+  bool start_array(std::size_t elements) { ++events[Profile::START_ARRAY]; return parser.start_array(elements); }
+  bool end_array() { ++events[Profile::END_ARRAY]; return parser.end_array(); }
+  bool key(string_t &val) { ++events[Profile::KEY]; return parser.key(val); }
+
+  bool parse_error(std::size_t position, const std::string &last_token, const nl::detail::exception &ex)
+  {
+    return parser.parse_error(position, last_token, ex);
+  }
+};
+
+// Keeps the first object of every shape, with the names of the objects merged into it as aliases
+class ObjectMerger
+{
+  std::unordered_map<std::string, std::string> m_shapes;
+
+public:
+  nl::json aliases = nl::json::object();
+
+  // Returns false if an object of the same shape was added before, which
+  // the object's name then stands for unless the two are named alike
+  bool add(nl::json &object)
+  {
+    for (auto &props : object["variables"]) {
+      if (props.count("className") && aliases.count(props["className"])) {
+        props["className"] = aliases[props["className"].get<std::string>()];
+      }
     }
 
+    // Objects are ordered by key, so equal members dump to the same text
+    const std::string className = object["className"];
+    auto shape = m_shapes.emplace(object["variables"].dump(), className);
+    if (!shape.second && shape.first->second != className) {
+      aliases[className] = shape.first->second;
+    }
+    return shape.second;
+  }
 };
 
+// Merges objects with identical members into the first of them, so that
+// every shape is generated once. The other names are listed under "aliases"
+// with the class they stand for, and members that referred to them refer to
+// it instead. Objects follow the objects they contain, which are therefore
+// merged before the shapes containing them are compared
+void mergeIdenticalObjects(nl::json &output)
+{
+  ObjectMerger merger;
+  nl::json objects = nl::json::array();
+
+  for (auto &object : output["objects"]) {
+    if (merger.add(object)) {
+      objects.push_back(std::move(object));
+    }
+  }
+
+  output["objects"] = std::move(objects);
+  output["aliases"] = std::move(merger.aliases);
 }
 
-int main(int argc, char *argv[])
+// Renders fragments of a file on worker threads while they are still being
+// produced. Fragments are rendered by whichever renderer is free and written
+// in the order they were pushed by a writer thread of their own. Pushing
+// blocks while `capacity` fragments are waiting to be rendered or written, and
+// the first error of a renderer is rethrown by the next push or by finish
+class RenderPipeline
 {
-  if (argc < 2) {
-    std::cerr << "Requires a schema file, output file and a base class name";
-    return 1;
+public:
+  using Render = std::function<void(std::ostream &out, const std::string &file, const nl::json &data)>;
+
+  RenderPipeline(std::ostream &out, Render render, std::size_t renderers, std::size_t capacity)
+    : m_out(out), m_render(std::move(render)), m_capacity(capacity)
+  {
+    for (std::size_t i = 0; i < renderers; ++i) {
+      m_threads.emplace_back([this] { renderFragments(); });
+    }
+    m_threads.emplace_back([this] { writeFragments(); });
   }
 
-  const char *fName = argv[1];
-  const char *ofName = argv[2];
+  RenderPipeline(const RenderPipeline &) = delete;
+  RenderPipeline &operator=(const RenderPipeline &) = delete;
 
-  std::ifstream schemaFile(fName);
+  ~RenderPipeline()
+  {
+    close();
+  }
 
-  jschema::SchemaTemplateParser tParser("Base");
-  nl::json::sax_parse(schemaFile, &tParser);
+  // Queues the file rendered with data, followed by suffix
+  void push(std::string file, nl::json data, std::string suffix = "")
+  {
+    std::unique_lock<std::mutex> lock(m_mutex);
+    m_changed.wait(lock, [this] { return m_error || m_pushed - m_written < m_capacity; });
+    if (m_error) {
+      std::rethrow_exception(m_error);
+    }
+    m_queued.push_back({m_pushed++, std::move(file), std::move(data), std::move(suffix)});
+    m_changed.notify_all();
+  }
 
-  std::ofstream outFile("source.h");
+  // Waits until every fragment is written
+  void finish()
+  {
+    close();
+    if (m_error) {
+      std::rethrow_exception(m_error);
+    }
+  }
 
-  std::cout << tParser.output.dump(4) << std::endl;
+private:
+  struct Fragment
+  {
+    std::size_t index;
+    std::string file;
+    nl::json data;
+    std::string suffix;
+  };
+
+  void close()
+  {
+    {
+      std::lock_guard<std::mutex> lock(m_mutex);
+      m_closed = true;
+    }
+    m_changed.notify_all();
+    for (auto &thread : m_threads) {
+      thread.join();
+    }
+    m_threads.clear();
+  }
+
+  void fail(std::exception_ptr error)
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (!m_error) {
+      m_error = error;
+    }
+    m_queued.clear();
+    m_changed.notify_all();
+  }
+
+  void renderFragments()
+  {
+    for (;;) {
+      Fragment fragment;
+      {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        m_changed.wait(lock, [this] { return m_closed || !m_queued.empty(); });
+        if (m_queued.empty()) {
+          return;
+        }
+        fragment = std::move(m_queued.front());
+        m_queued.pop_front();
+      }
+
+      std::ostringstream out;
+      try {
+        m_render(out, fragment.file, fragment.data);
+      } catch (...) {
+        fail(std::current_exception());
+        return;
+      }
+      out << fragment.suffix;
+
+      std::lock_guard<std::mutex> lock(m_mutex);
+      m_rendered.emplace(fragment.index, out.str());
+      m_changed.notify_all();
+    }
+  }
+
+  void writeFragments()
+  {
+    for (;;) {
+      std::string text;
+      {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        m_changed.wait(lock, [this] {
+          return m_rendered.count(m_written) || m_error || (m_closed && m_written == m_pushed);
+        });
+        if (!m_rendered.count(m_written)) {
+          return;
+        }
+        text = std::move(m_rendered[m_written]);
+        m_rendered.erase(m_written);
+      }
+
+      {
+        Profile::Timer timer(PROFILE, Profile::OUTPUT_WRITE);
+        m_out << text;
+      }
+
+      std::lock_guard<std::mutex> lock(m_mutex);
+      m_written += 1;
+      m_changed.notify_all();
+    }
+  }
+
+  std::ostream &m_out;
+  Render m_render;
+  const std::size_t m_capacity;
+
+  std::mutex m_mutex;
+  std::condition_variable m_changed;
+  std::deque<Fragment> m_queued;
+  std::map<std::size_t, std::string> m_rendered;
+  std::size_t m_pushed = 0;
+  std::size_t m_written = 0;
+  bool m_closed = false;
+  std::exception_ptr m_error;
+
+  std::vector<std::thread> m_threads;
+};
+
+// Writes the struct header while the schema is parsed. Every object is
+// queued for rendering as soon as its properties end, after the enums it
+// uses, and is then dropped, so that only the objects still open and those
+// waiting in the pipeline are kept in memory
+class StreamingEmitter
+{
+public:
+  explicit StreamingEmitter(RenderPipeline &pipeline)
+    : m_pipeline(pipeline)
+  {
+    m_pipeline.push("header.jinja2", nl::json::object(), "\n");
+  }
+
+  void object(nl::json &object, nl::json &enums)
+  {
+    for (auto &item : enums.items()) {
+      if (m_declared.insert(item.key()).second) {
+        PROFILE.enums += 1;
+        m_pipeline.push("enum.jinja2", {{"enumName", item.key()}, {"enumItems", std::move(item.value())}}, "\n");
+      }
+    }
+    enums = nl::json::object();
+
+    // Aliases follow the object they stand for, which has been queued already
+    const std::string className = object["className"];
+    if (m_merger.add(object)) {
+      PROFILE.objects += 1;
+      PROFILE.properties += object["variables"].size();
+      nl::json data;
+      data["object"] = std::move(object);
+      m_pipeline.push("struct.jinja2", std::move(data), "\n");
+    } else if (m_merger.aliases.count(className) && m_declared.insert(className).second) {
+      PROFILE.aliases += 1;
+      m_pipeline.push("alias.jinja2", {{"alias", className}, {"target", m_merger.aliases[className]}});
+    }
+  }
+
+private:
+  RenderPipeline &m_pipeline;
+  ObjectMerger m_merger;
+  std::set<std::string> m_declared;
+};
+
+// Lists the types each object refers to, which its header includes when
+// every type has a header of its own
+void addDependencies(nl::json &output)
+{
+  for (auto &object : output["objects"]) {
+    std::set<std::string> dependencies;
+    for (const auto &props : object["variables"]) {
+      if (props.count("className") && props["className"] != object["className"]) {
+        dependencies.insert(props["className"].get<std::string>());
+      }
+    }
+    object["dependencies"] = dependencies;
+  }
+}
+
+// Leaves files whose content is unchanged untouched, so that only what
+// includes a changed type is rebuilt. Returns false, having reported it,
+// if the file cannot be written
+bool writeIfChanged(const std::string &fileName, const std::string &content)
+{
+  std::ifstream existing(fileName, std::ios::binary | std::ios::ate);
+  if (existing && static_cast<std::size_t>(existing.tellg()) == content.size()) {
+    std::string current(content.size(), '\0');
+    existing.seekg(0);
+    if (existing.read(&current[0], current.size()) && current == content) {
+      return true;
+    }
+  }
+
+  std::ofstream out(fileName, std::ios::binary);
+  out << content;
+  out.close();
+  if (!out) {
+    std::cerr << "Cannot write " << fileName << std::endl;
+    return false;
+  }
+  return true;
+}
+
+// Wire type, size and alignment of a member in the fixed-offset layout
+struct FlatSlot
+{
+  std::string wire;
+  std::size_t size;
+  std::size_t align;
+};
+
+static std::map<std::string, FlatSlot> FLAT_SCALARS = {
+  {"number",  {"double", 8, 8}},
+  {"boolean", {"bool", 1, 1}},
+  {"string",  {"String", 8, 4}},
+  {"uuid",    {"boost::uuids::uuid", 16, 1}},
+};
+
+// Computes the fixed-offset layout used by templates/flat.h.jinja2 and
+// stores it under "flat" in each object and variable. A record begins with
+// a presence bitmask for its optional members, followed by the members at
+// their natural alignment. Nested objects are stored inline, strings and
+// arrays as an (offset, length) pair into the heap after the root record
+struct FlatLayout
+{
+  explicit FlatLayout(nl::json &output)
+    : m_output(output)
+  {
+    for (auto &object : m_output["objects"]) {
+      m_objects[object["className"]] = &object;
+    }
+  }
+
+  bool compute()
+  {
+    for (auto &object : m_output["objects"]) {
+      if (!layout(object)) {
+        return false;
+      }
+    }
+
+    return true;
+  }
+
+private:
+  nl::json &m_output;
+  std::map<std::string, nl::json *> m_objects;
+  std::set<std::string> m_visiting;
+
+  static std::size_t alignUp(std::size_t n, std::size_t align)
+  {
+    return (n + align - 1) / align * align;
+  }
+
+  bool slot(const std::string &name, const nl::json &props, FlatSlot &result)
+  {
+    const std::string &typeStr = props["type"];
+
+    if (props.count("className")) {
+      const std::string &className = props["className"];
+      if (m_output["enums"].count(className)) {
+        result = {"Enum<::" + className + ">", 4, 4};
+        return true;
+      }
+
+      if (!m_objects.count(className)) {
+        std::cerr << "Flat layout: unknown class " << className << " for " << name << std::endl;
+        return false;
+      }
+
+      nl::json &object = *m_objects.at(className);
+      if (!layout(object)) {
+        return false;
+      }
+
+      result = {className, object["flat"]["size"], 8};
+      return true;
+    }
+
+    // Integers are stored with the width of their narrowed type
+    if (typeStr == "integer") {
+      std::string type = integerType(props);
+      for (const auto &integer : INTEGER_TYPES) {
+        if (integer.name == type) {
+          result = {type, integer.size, integer.size};
+          return true;
+        }
+      }
+    }
+
+    if (!FLAT_SCALARS.count(typeStr)) {
+      std::cerr << "Flat layout: no fixed size for type " << typeStr << " of " << name << std::endl;
+      return false;
+    }
+
+    result = FLAT_SCALARS.at(typeStr);
+    return true;
+  }
+
+  bool layout(nl::json &object)
+  {
+    if (object.count("flat")) {
+      return true;
+    }
+
+    const std::string &className = object["className"];
+    if (!m_visiting.insert(className).second) {
+      std::cerr << "Flat layout: " << className << " contains itself inline" << std::endl;
+      return false;
+    }
+
+    std::size_t optionals = 0;
+    for (auto &variable : object["variables"]) {
+      if (!variable.count("isArray") && !variable.count("isRequired")) {
+        variable["flat"]["presenceBit"] = optionals++;
+      }
+    }
+
+    std::size_t size = (optionals + 7) / 8;
+    for (auto &item : object["variables"].items()) {
+      nl::json &props = item.value();
+      FlatSlot member;
+
+      if (props.count("isArray")) {
+        // Array elements live in the heap, so they never need the element
+        // layout here and recursion through arrays is fine
+        nl::json element = props;
+        element.erase("isArray");
+        if (element.count("className") && !m_output["enums"].count(element["className"])) {
+          member.wire = element["className"].get<std::string>();
+        } else if (!slot(item.key(), element, member)) {
+          return false;
+        }
+        member = {"Array<" + member.wire + ">", 8, 4};
+      } else if (!slot(item.key(), props, member)) {
+        return false;
+      }
+
+      size = alignUp(size, member.align);
+      props["flat"]["offset"] = size;
+      props["flat"]["wire"] = member.wire;
+      size += member.size;
+    }
+
+    object["flat"]["size"] = alignUp(std::max<std::size_t>(size, 1), 8);
+    m_visiting.erase(className);
+    return true;
+  }
+};
+
+// Templates that the generator renders, relative to the templates directory
+const std::vector<std::string> TEMPLATE_FILES = {
+  "header.jinja2",
+  "enum.jinja2",
+  "struct.jinja2",
+  "alias.jinja2",
+  "source.h.jinja2",
+  "msgpack.h.jinja2",
+  "cbor.h.jinja2",
+  "flat.h.jinja2",
+  "json.h.jinja2",
+  "split.h.jinja2",
+  "split.fwd.h.jinja2",
+  "split.enum.h.jinja2",
+  "split.struct.h.jinja2",
+  "module.cppm.jinja2",
+  "module.split.cppm.jinja2",
+  "module.enum.cppm.jinja2",
+  "module.struct.cppm.jinja2"
+};
+
+// Writes every template as a C++ render function, eg. render_source_h for source.h.jinja2,
+// for a generator built with JSCHEMA_COMPILED_TEMPLATES
+void compileTemplates(inja::Environment &env, std::ostream &out)
+{
+  out << "// Generated by jschema-cpp --compile-templates, do not edit\n";
+  out << "#pragma once\n\n#include <ostream>\n#include <string>\n\n#include \"inja/inja.hpp\"\n\n";
+  out << "namespace jschema {\nnamespace templates {\n\n";
+
+  std::vector<std::string> names;
+  for (const auto &file : TEMPLATE_FILES) {
+    std::string name = "render_" + file.substr(0, file.rfind(".jinja2"));
+    std::replace(name.begin(), name.end(), '.', '_');
+    out << env.compile_to_cpp(env.parse_file("templates/" + file), name) << "\n";
+    names.push_back(name);
+  }
+
+  out << "inline inja::aot::CompiledTemplate find(const std::string &file)\n{\n";
+  for (std::size_t i = 0; i < TEMPLATE_FILES.size(); ++i) {
+    out << "  if (file == \"" << TEMPLATE_FILES[i] << "\") {\n    return " << names[i] << ";\n  }\n";
+  }
+  out << "  return nullptr;\n}\n\n}\n}\n";
+}
+
+}
+
+static const char *USAGE =
+  "Usage: jschema-cpp <schema file> [output file] [--codec msgpack|cbor|flat|json]... [--split] [--module <name>]\n"
+  "                   [--stream] [--profile table|json] [--profile-templates]\n"
+  "       jschema-cpp --compile-templates <output file>\n";
+
+int main(int argc, char *argv[])
+{
+  std::vector<std::string> positional;
+  std::vector<std::string> codecs;
+  std::string compiledName;
+  std::string moduleName;
+  bool split = false;
+  bool stream = false;
+  std::string profileFormat;
+  bool profileTemplates = false;
+
+  for (int i = 1; i < argc; ++i) {
+    std::string arg = argv[i];
+    const bool takesValue = arg == "--codec" || arg == "--compile-templates" || arg == "--module" || arg == "--profile";
+    if (takesValue && i + 1 == argc) {
+      std::cerr << arg << " requires a value\n" << USAGE;
+      return 1;
+    }
+    if (arg == "--codec") {
+      codecs.push_back(argv[++i]);
+    } else if (arg == "--compile-templates") {
+      compiledName = argv[++i];
+    } else if (arg == "--module") {
+      moduleName = argv[++i];
+    } else if (arg == "--split") {
+      split = true;
+    } else if (arg == "--stream") {
+      stream = true;
+    } else if (arg == "--profile-templates") {
+      profileTemplates = true;
+    } else if (arg == "--profile") {
+      profileFormat = argv[++i];
+    } else if (arg.size() > 1 && arg[0] == '-') {
+      std::cerr << "Unknown option: " << arg << "\n" << USAGE;
+      return 1;
+    } else {
+      positional.push_back(arg);
+    }
+  }
 
   inja::Environment env;
   env.set_trim_blocks(true);
   env.set_lstrip_blocks(true);
+  env.set_compile_bytecode(true);
 
   env.add_callback("cppType", 1, [](inja::Arguments &args) {
     auto props = args.at(0)->get<inja::json>();
@@ -627,7 +1765,9 @@ int main(int argc, char *argv[])
 
     if (jschema::TOKEN_TYPES.count(typeStr)) {
       auto tp = jschema::TOKEN_TYPES.at(typeStr);
-      if (jschema::CPP_TYPES.count(tp)) {
+      if (tp == jschema::INTEGER) {
+        cppType = jschema::integerType(props);
+      } else if (jschema::CPP_TYPES.count(tp)) {
         cppType = jschema::CPP_TYPES.at(tp);
       }
     }
@@ -653,6 +1793,259 @@ int main(int argc, char *argv[])
     return cppType;
   });
 
-  env.render_to(outFile, env.parse_file("templates/source.h.jinja2"), tParser.output);
-  
-}
\ No newline at end of file
+  env.add_callback("rangeCheck", 1, [](inja::Arguments &args) {
+    return jschema::rangeCheck(args.at(0)->get<inja::json>());
+  });
+
+  env.add_callback("msgpackKey", 1, [](inja::Arguments &args) {
+    return jschema::cppStringLiteral(jschema::msgpackString(args.at(0)->get<std::string>()));
+  });
+
+  env.add_callback("cborKey", 1, [](inja::Arguments &args) {
+    return jschema::cppStringLiteral(jschema::cborString(args.at(0)->get<std::string>()));
+  });
+
+  env.add_callback("cppString", 1, [](inja::Arguments &args) {
+    return jschema::cppStringLiteral(args.at(0)->get<std::string>());
+  });
+
+  env.add_callback("jsonString", 1, [](inja::Arguments &args) {
+    return jschema::cppStringLiteral(args.at(0)->dump());
+  });
+
+  if (!compiledName.empty()) {
+    std::ofstream compiledFile(compiledName);
+    if (!compiledFile) {
+      std::cerr << "Cannot open " << compiledName << " for writing" << std::endl;
+      return 1;
+    }
+    jschema::compileTemplates(env, compiledFile);
+    compiledFile.close();
+    if (!compiledFile) {
+      std::cerr << "Cannot write " << compiledName << std::endl;
+      return 1;
+    }
+    return 0;
+  }
+
+  if (positional.empty()) {
+    std::cerr << "Requires a schema file, output file and a base class name";
+    return 1;
+  }
+
+  for (const auto &codec : codecs) {
+    if (codec != "msgpack" && codec != "cbor" && codec != "flat" && codec != "json") {
+      std::cerr << "Unknown codec: " << codec << ", expected msgpack, cbor, flat or json";
+      return 1;
+    }
+  }
+
+  if (!moduleName.empty() && !codecs.empty()) {
+    std::cerr << "Codecs include the struct header and cannot be used with --module";
+    return 1;
+  }
+
+  if (!profileFormat.empty() && profileFormat != "table" && profileFormat != "json") {
+    std::cerr << "Unknown profile format: " << profileFormat << ", expected table or json";
+    return 1;
+  }
+
+  if (stream && (split || !moduleName.empty() || !codecs.empty())) {
+    std::cerr << "--stream only writes the struct header and cannot be used with --split, --module or codecs";
+    return 1;
+  }
+
+  const std::string fName = positional[0];
+  const std::string ofName = positional.size() > 1 ? positional[1] : "source.h";
+
+  std::ifstream schemaFile(fName);
+
+  // Rendering is measured node by node, from the template files even if they are compiled in
+  inja::RenderProfiler templateProfiler;
+  if (profileTemplates) {
+    env.set_profiler(&templateProfiler);
+  }
+
+  // Templates compiled into the generator are used in place of the files,
+  // the others are parsed once and rendered for every type that uses them
+  std::map<std::string, inja::Template> parsed;
+  std::mutex parsedMutex;
+  auto renderTo = [&env, &parsed, &parsedMutex, profileTemplates](std::ostream &out, const std::string &file,
+                                                                   const nl::json &data) {
+#ifdef JSCHEMA_COMPILED_TEMPLATES
+    inja::aot::CompiledTemplate compiled = profileTemplates ? nullptr : jschema::templates::find(file);
+    if (compiled) {
+      jschema::Profile::Timer timer(jschema::PROFILE, jschema::Profile::RENDER);
+      env.render_to(out, compiled, data);
+      return;
+    }
+#endif
+    std::unique_lock<std::mutex> lock(parsedMutex);
+    auto found = parsed.find(file);
+    if (found == parsed.end()) {
+      jschema::Profile::Timer timer(jschema::PROFILE, jschema::Profile::TEMPLATE_PARSE);
+      found = parsed.emplace(file, env.parse_file("templates/" + file)).first;
+    }
+    lock.unlock();
+    jschema::Profile::Timer timer(jschema::PROFILE, jschema::Profile::RENDER);
+    env.render_to(out, found->second, data);
+  };
+
+  // Files that cannot be written are reported as they are found and fail the run once it is done
+  bool written = true;
+  auto render = [&renderTo, &written](const std::string &fileName, const std::string &file, const nl::json &data) {
+    std::ostringstream out;
+    renderTo(out, file, data);
+    jschema::Profile::Timer timer(jschema::PROFILE, jschema::Profile::OUTPUT_WRITE);
+    written &= jschema::writeIfChanged(fileName, out.str());
+  };
+
+  jschema::SchemaTemplateParser tParser("Base");
+
+  // Events are only counted when profiling. Returns false if the schema is
+  // invalid, which the parser has reported
+  auto parseSchema = [&schemaFile, &tParser, &profileFormat]() {
+    jschema::Profile::Timer timer(jschema::PROFILE, jschema::Profile::SAX_PARSE);
+    if (profileFormat.empty()) {
+      return nl::json::sax_parse(schemaFile, &tParser);
+    }
+    jschema::CountingSax<jschema::SchemaTemplateParser> counting {tParser, jschema::PROFILE.events};
+    return nl::json::sax_parse(schemaFile, &counting);
+  };
+  auto printProfile = [&profileFormat, &templateProfiler, profileTemplates]() {
+    if (!profileFormat.empty()) {
+      jschema::PROFILE.print(std::cerr, profileFormat == "json");
+    }
+    if (profileTemplates) {
+      templateProfiler.write_report(std::cerr);
+    }
+  };
+
+  // Parsing, rendering and writing the streamed header overlap, with one
+  // renderer per core and up to 256 fragments in flight
+  if (stream) {
+    std::ofstream outFile(ofName);
+    if (!outFile) {
+      std::cerr << "Cannot write " << ofName << std::endl;
+      return 1;
+    }
+    jschema::RenderPipeline pipeline(outFile, renderTo, std::max(std::thread::hardware_concurrency(), 1u), 256);
+    jschema::StreamingEmitter emitter(pipeline);
+    tParser.emitObject = [&emitter, &tParser](nl::json &object) {
+      emitter.object(object, tParser.output["enums"]);
+    };
+    const bool parsed = parseSchema();
+    pipeline.finish();
+    outFile.close();
+    if (!outFile) {
+      std::cerr << "Cannot write " << ofName << std::endl;
+    }
+    printProfile();
+    return parsed && outFile ? 0 : 1;
+  }
+
+  if (!parseSchema()) {
+    return 1;
+  }
+
+  {
+    jschema::Profile::Timer timer(jschema::PROFILE, jschema::Profile::IR_BUILD);
+    jschema::mergeIdenticalObjects(tParser.output);
+
+    if (std::find(codecs.begin(), codecs.end(), "flat") != codecs.end()) {
+      jschema::FlatLayout layout(tParser.output);
+      if (!layout.compute()) {
+        return 1;
+      }
+    }
+  }
+  jschema::PROFILE.count(tParser.output);
+
+  // Binary codec headers include the struct header by its file name
+  const std::string directory = ofName.substr(0, ofName.find_last_of("/\\") + 1);
+  tParser.output["header"] = ofName.substr(directory.size());
+
+  // Names a header next to the struct header, eg. source.msgpack.h
+  auto sibling = [&ofName](const std::string &part) {
+    std::string name = ofName;
+    std::size_t extension = name.rfind(".h");
+    if (extension == std::string::npos || extension + 2 != name.size()) {
+      extension = name.size();
+    }
+    return name.insert(extension, "." + part);
+  };
+
+  // Modules are written as interface units, with a partition per type when split
+  const std::string typeExtension = moduleName.empty() ? ".h" : ".cppm";
+  if (!moduleName.empty()) {
+    tParser.output["module"] = moduleName;
+  }
+
+  if (split) {
+    jschema::Profile::Timer timer(jschema::PROFILE, jschema::Profile::IR_BUILD);
+    jschema::addDependencies(tParser.output);
+    tParser.output["forward"] = sibling("fwd").substr(directory.size());
+
+    // Type headers are named after their type and must not replace the headers that include them
+    std::set<std::string> typeHeaders;
+    for (const auto &item : tParser.output["enums"].items()) {
+      typeHeaders.insert(item.key() + typeExtension);
+    }
+    for (const auto &object : tParser.output["objects"]) {
+      typeHeaders.insert(object["className"].get<std::string>() + typeExtension);
+    }
+    for (const std::string name : {tParser.output["header"], tParser.output["forward"]}) {
+      if (typeHeaders.count(name)) {
+        std::cerr << "Output file " << name << " has the same name as a type header";
+        return 1;
+      }
+    }
+  }
+
+  std::cout << tParser.output.dump(4) << std::endl;
+
+  if (split && !moduleName.empty()) {
+    // One partition per type, which imports the partitions of the types it refers to
+    for (const auto &item : tParser.output["enums"].items()) {
+      render(directory + item.key() + typeExtension, "module.enum.cppm.jinja2",
+             {{"enumName", item.key()}, {"enumItems", item.value()}, {"module", moduleName}});
+    }
+    for (const auto &object : tParser.output["objects"]) {
+      render(directory + object["className"].get<std::string>() + typeExtension, "module.struct.cppm.jinja2",
+             {{"object", object}, {"module", moduleName}});
+    }
+    render(ofName, "module.split.cppm.jinja2", tParser.output);
+  } else if (!moduleName.empty()) {
+    render(ofName, "module.cppm.jinja2", tParser.output);
+  } else if (split) {
+    // One header per type, which includes the forward declarations and the headers of the types it refers to
+    render(sibling("fwd"), "split.fwd.h.jinja2", tParser.output);
+    for (const auto &item : tParser.output["enums"].items()) {
+      render(directory + item.key() + ".h", "split.enum.h.jinja2",
+             {{"enumName", item.key()}, {"enumItems", item.value()}});
+    }
+    for (const auto &object : tParser.output["objects"]) {
+      render(directory + object["className"].get<std::string>() + ".h", "split.struct.h.jinja2",
+             {{"object", object}, {"forward", tParser.output["forward"]}});
+    }
+    render(ofName, "split.h.jinja2", tParser.output);
+  } else {
+    render(ofName, "source.h.jinja2", tParser.output);
+  }
+
+  for (const auto &codec : codecs) {
+    render(sibling(codec), codec + ".h.jinja2", tParser.output);
+
+    // The JSON codec builds on the runtime header, which is copied as is
+    if (codec == "json") {
+      jschema::Profile::Timer timer(jschema::PROFILE, jschema::Profile::OUTPUT_WRITE);
+      std::ifstream runtimeIn("templates/jschema_runtime.h", std::ios::binary);
+      std::ostringstream runtime;
+      runtime << runtimeIn.rdbuf();
+      written &= jschema::writeIfChanged(directory + "jschema_runtime.h", runtime.str());
+    }
+  }
+
+  printProfile();
+  return written ? 0 : 1;
+}
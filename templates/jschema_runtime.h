@@ -0,0 +1,848 @@
+#pragma once
+
+// Runtime support for the JSON text codec generated by jschema-cpp. This
+// header is self-contained and copied next to the generated sources.
+//
+// Decoding runs in two stages. Stage one classifies the input 64 bytes at a
+// time (AVX2 or NEON when the compiler targets them, scalar otherwise) and
+// records the offset of every structural character, every unescaped quote
+// and the first byte of every number or literal. Stage two, the generated
+// decoders, walk that index: the end of a string is the next index entry and
+// unknown subtrees are skipped by counting brackets in the index instead of
+// scanning bytes.
+
+#include <charconv>
+#include <clocale>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <system_error>
+#include <vector>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__aarch64__) && defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
+
+namespace jschema {
+namespace runtime {
+
+struct decode_error : std::runtime_error
+{
+  using std::runtime_error::runtime_error;
+};
+
+struct encode_error : std::runtime_error
+{
+  using std::runtime_error::runtime_error;
+};
+
+// Character classes of one 64 byte block, bit i describing byte i
+struct BlockMasks
+{
+  std::uint64_t quote;
+  std::uint64_t backslash;
+  std::uint64_t structural;
+  std::uint64_t whitespace;
+};
+
+inline BlockMasks classify_scalar(const unsigned char *p)
+{
+  BlockMasks m{0, 0, 0, 0};
+  for (int i = 0; i < 64; ++i) {
+    std::uint64_t bit = std::uint64_t(1) << i;
+    switch (p[i]) {
+      case '"': m.quote |= bit; break;
+      case '\\': m.backslash |= bit; break;
+      case '{': case '}': case '[': case ']': case ':': case ',': m.structural |= bit; break;
+      case ' ': case '\t': case '\n': case '\r': m.whitespace |= bit; break;
+      default: break;
+    }
+  }
+  return m;
+}
+
+#if defined(__AVX2__)
+
+inline BlockMasks classify(const unsigned char *p)
+{
+  BlockMasks m{0, 0, 0, 0};
+  for (int half = 0; half < 2; ++half) {
+    __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(p + half * 32));
+    // Setting bit 5 maps '[' and ']' onto '{' and '}'
+    __m256i folded = _mm256_or_si256(v, _mm256_set1_epi8(0x20));
+
+    __m256i quote = _mm256_cmpeq_epi8(v, _mm256_set1_epi8('"'));
+    __m256i backslash = _mm256_cmpeq_epi8(v, _mm256_set1_epi8('\\'));
+    __m256i structural = _mm256_or_si256(
+      _mm256_or_si256(_mm256_cmpeq_epi8(folded, _mm256_set1_epi8('{')), _mm256_cmpeq_epi8(folded, _mm256_set1_epi8('}'))),
+      _mm256_or_si256(_mm256_cmpeq_epi8(v, _mm256_set1_epi8(':')), _mm256_cmpeq_epi8(v, _mm256_set1_epi8(','))));
+    __m256i whitespace = _mm256_or_si256(
+      _mm256_or_si256(_mm256_cmpeq_epi8(v, _mm256_set1_epi8(' ')), _mm256_cmpeq_epi8(v, _mm256_set1_epi8('\t'))),
+      _mm256_or_si256(_mm256_cmpeq_epi8(v, _mm256_set1_epi8('\n')), _mm256_cmpeq_epi8(v, _mm256_set1_epi8('\r'))));
+
+    int shift = half * 32;
+    m.quote |= std::uint64_t(std::uint32_t(_mm256_movemask_epi8(quote))) << shift;
+    m.backslash |= std::uint64_t(std::uint32_t(_mm256_movemask_epi8(backslash))) << shift;
+    m.structural |= std::uint64_t(std::uint32_t(_mm256_movemask_epi8(structural))) << shift;
+    m.whitespace |= std::uint64_t(std::uint32_t(_mm256_movemask_epi8(whitespace))) << shift;
+  }
+
+  return m;
+}
+
+#elif defined(__aarch64__) && defined(__ARM_NEON)
+
+// NEON has no movemask, so each lane keeps one bit and pairwise additions
+// fold the four vectors into one 64 bit mask
+inline std::uint64_t neon_movemask(uint8x16_t m0, uint8x16_t m1, uint8x16_t m2, uint8x16_t m3)
+{
+  const uint8x16_t bits = {0x01, 0x02, 0x04, 0x08, 0x10, 0x20, 0x40, 0x80,
+                           0x01, 0x02, 0x04, 0x08, 0x10, 0x20, 0x40, 0x80};
+  uint8x16_t sum0 = vpaddq_u8(vandq_u8(m0, bits), vandq_u8(m1, bits));
+  uint8x16_t sum1 = vpaddq_u8(vandq_u8(m2, bits), vandq_u8(m3, bits));
+  sum0 = vpaddq_u8(sum0, sum1);
+  sum0 = vpaddq_u8(sum0, sum0);
+  return vgetq_lane_u64(vreinterpretq_u64_u8(sum0), 0);
+}
+
+inline BlockMasks classify(const unsigned char *p)
+{
+  uint8x16_t v[4], quote[4], backslash[4], structural[4], whitespace[4];
+  for (int i = 0; i < 4; ++i) {
+    v[i] = vld1q_u8(p + i * 16);
+    // Setting bit 5 maps '[' and ']' onto '{' and '}'
+    uint8x16_t folded = vorrq_u8(v[i], vdupq_n_u8(0x20));
+    quote[i] = vceqq_u8(v[i], vdupq_n_u8('"'));
+    backslash[i] = vceqq_u8(v[i], vdupq_n_u8('\\'));
+    structural[i] = vorrq_u8(vorrq_u8(vceqq_u8(folded, vdupq_n_u8('{')), vceqq_u8(folded, vdupq_n_u8('}'))),
+                             vorrq_u8(vceqq_u8(v[i], vdupq_n_u8(':')), vceqq_u8(v[i], vdupq_n_u8(','))));
+    whitespace[i] = vorrq_u8(vorrq_u8(vceqq_u8(v[i], vdupq_n_u8(' ')), vceqq_u8(v[i], vdupq_n_u8('\t'))),
+                             vorrq_u8(vceqq_u8(v[i], vdupq_n_u8('\n')), vceqq_u8(v[i], vdupq_n_u8('\r'))));
+  }
+
+  return BlockMasks{
+    neon_movemask(quote[0], quote[1], quote[2], quote[3]),
+    neon_movemask(backslash[0], backslash[1], backslash[2], backslash[3]),
+    neon_movemask(structural[0], structural[1], structural[2], structural[3]),
+    neon_movemask(whitespace[0], whitespace[1], whitespace[2], whitespace[3]),
+  };
+}
+
+#else
+
+inline BlockMasks classify(const unsigned char *p)
+{
+  return classify_scalar(p);
+}
+
+#endif
+
+inline int trailing_zeroes(std::uint64_t x)
+{
+#if defined(__GNUC__) || defined(__clang__)
+  return __builtin_ctzll(x);
+#else
+  int n = 0;
+  while (!(x & 1)) {
+    x >>= 1;
+    ++n;
+  }
+  return n;
+#endif
+}
+
+// Bit i of the result is the parity of bits 0 to i, which turns a mask of
+// quotes into a mask of the bytes inside strings
+inline std::uint64_t prefix_xor(std::uint64_t x)
+{
+  x ^= x << 1;
+  x ^= x << 2;
+  x ^= x << 4;
+  x ^= x << 8;
+  x ^= x << 16;
+  x ^= x << 32;
+  return x;
+}
+
+// Builds the stage one index described at the top of this header
+class StructuralIndexer
+{
+public:
+  std::vector<std::uint32_t> index(const char *data, std::size_t size)
+  {
+    if (size > UINT32_MAX) {
+      throw decode_error("json: documents larger than 4GB are not supported");
+    }
+
+    m_escapeNext = false;
+    m_inString = 0;
+    m_followsSeparator = 1;
+
+    std::vector<std::uint32_t> result;
+    result.reserve(size / 8 + 8);
+
+    const auto *in = reinterpret_cast<const unsigned char *>(data);
+    std::size_t offset = 0;
+    for (; offset + 64 <= size; offset += 64) {
+      block(in + offset, offset, result);
+    }
+
+    if (offset < size) {
+      unsigned char tail[64];
+      std::memset(tail, ' ', sizeof(tail));
+      std::memcpy(tail, in + offset, size - offset);
+      block(tail, offset, result);
+    }
+
+    if (m_inString) {
+      throw decode_error("json: unterminated string");
+    }
+
+    return result;
+  }
+
+private:
+  bool m_escapeNext = false;
+  std::uint64_t m_inString = 0;
+  std::uint64_t m_followsSeparator = 1;
+
+  // Backslashes are rare, so escapes are resolved one backslash at a time
+  std::uint64_t escaped(std::uint64_t backslash)
+  {
+    std::uint64_t result = 0;
+    if (m_escapeNext) {
+      result |= 1;
+      backslash &= ~std::uint64_t(1);
+      m_escapeNext = false;
+    }
+
+    while (backslash) {
+      int i = trailing_zeroes(backslash);
+      if (i == 63) {
+        m_escapeNext = true;
+        break;
+      }
+      result |= std::uint64_t(1) << (i + 1);
+      backslash &= ~(std::uint64_t(3) << i);
+    }
+
+    return result;
+  }
+
+  void block(const unsigned char *p, std::size_t offset, std::vector<std::uint32_t> &result)
+  {
+    BlockMasks m = classify(p);
+
+    std::uint64_t quotes = m.quote & ~escaped(m.backslash);
+    std::uint64_t inString = prefix_xor(quotes) ^ m_inString;
+    m_inString = (inString >> 63) ? ~std::uint64_t(0) : 0;
+
+    std::uint64_t separators = m.structural | m.whitespace;
+    std::uint64_t follows = (separators << 1) | m_followsSeparator;
+    m_followsSeparator = separators >> 63;
+
+    std::uint64_t scalarStarts = ~(separators | quotes) & ~inString & follows;
+    std::uint64_t bits = (m.structural & ~inString) | quotes | scalarStarts;
+
+    while (bits) {
+      result.push_back(static_cast<std::uint32_t>(offset + trailing_zeroes(bits)));
+      bits &= bits - 1;
+    }
+  }
+};
+
+// Walks a document through its structural index
+class Cursor
+{
+public:
+  Cursor(const char *data, std::size_t size, const std::uint32_t *begin, const std::uint32_t *end)
+    : m_data(data), m_size(size), m_pos(begin), m_end(end)
+  {
+  }
+
+  bool done() const { return m_pos == m_end; }
+
+  char peek() const
+  {
+    if (m_pos == m_end) {
+      throw decode_error("json: unexpected end of input");
+    }
+    return m_data[*m_pos];
+  }
+
+  void expect(char c)
+  {
+    if (peek() != c) {
+      throw decode_error(std::string("json: expected '") + c + "'");
+    }
+    ++m_pos;
+  }
+
+  bool consume(char c)
+  {
+    if (m_pos != m_end && m_data[*m_pos] == c) {
+      ++m_pos;
+      return true;
+    }
+    return false;
+  }
+
+  // The bytes between a pair of quotes, escapes included. The closing quote
+  // is always the next index entry
+  std::string_view raw_string()
+  {
+    if (peek() != '"' || m_pos + 1 == m_end || m_data[m_pos[1]] != '"') {
+      throw decode_error("json: expected string");
+    }
+    std::uint32_t begin = m_pos[0] + 1;
+    std::uint32_t end = m_pos[1];
+    m_pos += 2;
+    return std::string_view(m_data + begin, end - begin);
+  }
+
+  // A number or literal, which runs up to the next whitespace or index entry
+  std::string_view scalar()
+  {
+    char c = peek();
+    if (c == '"' || c == '{' || c == '}' || c == '[' || c == ']' || c == ':' || c == ',') {
+      throw decode_error("json: expected number or literal");
+    }
+
+    std::uint32_t begin = *m_pos++;
+    std::size_t limit = m_pos == m_end ? m_size : *m_pos;
+    std::size_t end = begin;
+    while (end < limit && m_data[end] != ' ' && m_data[end] != '\t' && m_data[end] != '\n' && m_data[end] != '\r') {
+      ++end;
+    }
+    return std::string_view(m_data + begin, end - begin);
+  }
+
+  bool null()
+  {
+    if (m_pos != m_end && m_data[*m_pos] == 'n') {
+      if (scalar() != "null") {
+        throw decode_error("json: expected null");
+      }
+      return true;
+    }
+    return false;
+  }
+
+  // Skips one value. Containers are skipped by counting brackets in the
+  // index, strings by stepping over their closing quote
+  void skip()
+  {
+    int depth = 0;
+    do {
+      char c = peek();
+      if (c == '{' || c == '[') {
+        ++depth;
+      } else if (c == '}' || c == ']') {
+        --depth;
+      } else if (c == '"') {
+        raw_string();
+        continue;
+      }
+      ++m_pos;
+    } while (depth > 0);
+
+    if (depth < 0) {
+      throw decode_error("json: unbalanced brackets");
+    }
+  }
+
+  // An object key followed by its ':'. Keys are compared unescaped
+  std::string_view key()
+  {
+    std::string_view raw = raw_string();
+    expect(':');
+    if (raw.find('\\') == std::string_view::npos) {
+      return raw;
+    }
+    m_key.clear();
+    unescape(raw, m_key);
+    return m_key;
+  }
+
+  static void append_utf8(std::string &out, std::uint32_t cp)
+  {
+    if (cp < 0x80) {
+      out += static_cast<char>(cp);
+    } else if (cp < 0x800) {
+      out += static_cast<char>(0xc0 | (cp >> 6));
+      out += static_cast<char>(0x80 | (cp & 0x3f));
+    } else if (cp < 0x10000) {
+      out += static_cast<char>(0xe0 | (cp >> 12));
+      out += static_cast<char>(0x80 | ((cp >> 6) & 0x3f));
+      out += static_cast<char>(0x80 | (cp & 0x3f));
+    } else {
+      out += static_cast<char>(0xf0 | (cp >> 18));
+      out += static_cast<char>(0x80 | ((cp >> 12) & 0x3f));
+      out += static_cast<char>(0x80 | ((cp >> 6) & 0x3f));
+      out += static_cast<char>(0x80 | (cp & 0x3f));
+    }
+  }
+
+  static std::uint32_t hex4(std::string_view raw, std::size_t at)
+  {
+    std::uint32_t value = 0;
+    if (at + 4 > raw.size() || std::from_chars(raw.data() + at, raw.data() + at + 4, value, 16).ptr != raw.data() + at + 4) {
+      throw decode_error("json: invalid \\u escape");
+    }
+    return value;
+  }
+
+  static void unescape(std::string_view raw, std::string &out)
+  {
+    out.reserve(out.size() + raw.size());
+    for (std::size_t i = 0; i < raw.size(); ++i) {
+      char c = raw[i];
+      if (c != '\\') {
+        out += c;
+        continue;
+      }
+
+      if (++i == raw.size()) {
+        throw decode_error("json: invalid escape");
+      }
+
+      switch (raw[i]) {
+        case '"': out += '"'; break;
+        case '\\': out += '\\'; break;
+        case '/': out += '/'; break;
+        case 'b': out += '\b'; break;
+        case 'f': out += '\f'; break;
+        case 'n': out += '\n'; break;
+        case 'r': out += '\r'; break;
+        case 't': out += '\t'; break;
+        case 'u': {
+          std::uint32_t cp = hex4(raw, i + 1);
+          i += 4;
+          if (cp >= 0xd800 && cp < 0xdc00 && i + 2 < raw.size() && raw[i + 1] == '\\' && raw[i + 2] == 'u') {
+            std::uint32_t low = hex4(raw, i + 3);
+            if (low >= 0xdc00 && low < 0xe000) {
+              cp = 0x10000 + ((cp - 0xd800) << 10) + (low - 0xdc00);
+              i += 6;
+            }
+          }
+          append_utf8(out, cp);
+        } break;
+        default: throw decode_error("json: invalid escape");
+      }
+    }
+  }
+
+private:
+  const char *m_data;
+  std::size_t m_size;
+  const std::uint32_t *m_pos;
+  const std::uint32_t *m_end;
+  std::string m_key;
+};
+
+inline void write_string(std::string &out, std::string_view value)
+{
+  static const char *HEX = "0123456789abcdef";
+  out += '"';
+  for (char c : value) {
+    switch (c) {
+      case '"': out += "\\\""; break;
+      case '\\': out += "\\\\"; break;
+      case '\b': out += "\\b"; break;
+      case '\f': out += "\\f"; break;
+      case '\n': out += "\\n"; break;
+      case '\r': out += "\\r"; break;
+      case '\t': out += "\\t"; break;
+      default:
+        if (static_cast<unsigned char>(c) < 0x20) {
+          out += "\\u00";
+          out += HEX[(c >> 4) & 0xf];
+          out += HEX[c & 0xf];
+        } else {
+          out += c;
+        }
+    }
+  }
+  out += '"';
+}
+
+template <typename T>
+void parse_integer(std::string_view text, T &value)
+{
+  auto result = std::from_chars(text.data(), text.data() + text.size(), value);
+  if (result.ec == std::errc::result_out_of_range) {
+    throw decode_error("json: integer out of range");
+  }
+  if (result.ec != std::errc() || result.ptr != text.data() + text.size()) {
+    throw decode_error("json: expected integer");
+  }
+}
+
+template <typename T>
+void write_integer(std::string &out, T value)
+{
+  char buffer[24];
+  auto result = std::to_chars(buffer, buffer + sizeof(buffer), value);
+  out.append(buffer, result.ptr);
+}
+
+// Significands of 5^q for the exponents decimal text commonly uses, as the
+// top 128 bits (rounded up for negative q) after normalising the top bit
+constexpr int POWER_OF_FIVE_MIN = -64;
+constexpr int POWER_OF_FIVE_MAX = 64;
+
+inline constexpr std::uint64_t POWERS_OF_FIVE[][2] = {
+  {0xa87fea27a539e9a5, 0x3f2398d747b36224}, // 5^-64
+  {0xd29fe4b18e88640e, 0x8eec7f0d19a03aad}, // 5^-63
+  {0x83a3eeeef9153e89, 0x1953cf68300424ac}, // 5^-62
+  {0xa48ceaaab75a8e2b, 0x5fa8c3423c052dd7}, // 5^-61
+  {0xcdb02555653131b6, 0x3792f412cb06794d}, // 5^-60
+  {0x808e17555f3ebf11, 0xe2bbd88bbee40bd0}, // 5^-59
+  {0xa0b19d2ab70e6ed6, 0x5b6aceaeae9d0ec4}, // 5^-58
+  {0xc8de047564d20a8b, 0xf245825a5a445275}, // 5^-57
+  {0xfb158592be068d2e, 0xeed6e2f0f0d56712}, // 5^-56
+  {0x9ced737bb6c4183d, 0x55464dd69685606b}, // 5^-55
+  {0xc428d05aa4751e4c, 0xaa97e14c3c26b886}, // 5^-54
+  {0xf53304714d9265df, 0xd53dd99f4b3066a8}, // 5^-53
+  {0x993fe2c6d07b7fab, 0xe546a8038efe4029}, // 5^-52
+  {0xbf8fdb78849a5f96, 0xde98520472bdd033}, // 5^-51
+  {0xef73d256a5c0f77c, 0x963e66858f6d4440}, // 5^-50
+  {0x95a8637627989aad, 0xdde7001379a44aa8}, // 5^-49
+  {0xbb127c53b17ec159, 0x5560c018580d5d52}, // 5^-48
+  {0xe9d71b689dde71af, 0xaab8f01e6e10b4a6}, // 5^-47
+  {0x9226712162ab070d, 0xcab3961304ca70e8}, // 5^-46
+  {0xb6b00d69bb55c8d1, 0x3d607b97c5fd0d22}, // 5^-45
+  {0xe45c10c42a2b3b05, 0x8cb89a7db77c506a}, // 5^-44
+  {0x8eb98a7a9a5b04e3, 0x77f3608e92adb242}, // 5^-43
+  {0xb267ed1940f1c61c, 0x55f038b237591ed3}, // 5^-42
+  {0xdf01e85f912e37a3, 0x6b6c46dec52f6688}, // 5^-41
+  {0x8b61313bbabce2c6, 0x2323ac4b3b3da015}, // 5^-40
+  {0xae397d8aa96c1b77, 0xabec975e0a0d081a}, // 5^-39
+  {0xd9c7dced53c72255, 0x96e7bd358c904a21}, // 5^-38
+  {0x881cea14545c7575, 0x7e50d64177da2e54}, // 5^-37
+  {0xaa242499697392d2, 0xdde50bd1d5d0b9e9}, // 5^-36
+  {0xd4ad2dbfc3d07787, 0x955e4ec64b44e864}, // 5^-35
+  {0x84ec3c97da624ab4, 0xbd5af13bef0b113e}, // 5^-34
+  {0xa6274bbdd0fadd61, 0xecb1ad8aeacdd58e}, // 5^-33
+  {0xcfb11ead453994ba, 0x67de18eda5814af2}, // 5^-32
+  {0x81ceb32c4b43fcf4, 0x80eacf948770ced7}, // 5^-31
+  {0xa2425ff75e14fc31, 0xa1258379a94d028d}, // 5^-30
+  {0xcad2f7f5359a3b3e, 0x096ee45813a04330}, // 5^-29
+  {0xfd87b5f28300ca0d, 0x8bca9d6e188853fc}, // 5^-28
+  {0x9e74d1b791e07e48, 0x775ea264cf55347e}, // 5^-27
+  {0xc612062576589dda, 0x95364afe032a819e}, // 5^-26
+  {0xf79687aed3eec551, 0x3a83ddbd83f52205}, // 5^-25
+  {0x9abe14cd44753b52, 0xc4926a9672793543}, // 5^-24
+  {0xc16d9a0095928a27, 0x75b7053c0f178294}, // 5^-23
+  {0xf1c90080baf72cb1, 0x5324c68b12dd6339}, // 5^-22
+  {0x971da05074da7bee, 0xd3f6fc16ebca5e04}, // 5^-21
+  {0xbce5086492111aea, 0x88f4bb1ca6bcf585}, // 5^-20
+  {0xec1e4a7db69561a5, 0x2b31e9e3d06c32e6}, // 5^-19
+  {0x9392ee8e921d5d07, 0x3aff322e62439fd0}, // 5^-18
+  {0xb877aa3236a4b449, 0x09befeb9fad487c3}, // 5^-17
+  {0xe69594bec44de15b, 0x4c2ebe687989a9b4}, // 5^-16
+  {0x901d7cf73ab0acd9, 0x0f9d37014bf60a11}, // 5^-15
+  {0xb424dc35095cd80f, 0x538484c19ef38c95}, // 5^-14
+  {0xe12e13424bb40e13, 0x2865a5f206b06fba}, // 5^-13
+  {0x8cbccc096f5088cb, 0xf93f87b7442e45d4}, // 5^-12
+  {0xafebff0bcb24aafe, 0xf78f69a51539d749}, // 5^-11
+  {0xdbe6fecebdedd5be, 0xb573440e5a884d1c}, // 5^-10
+  {0x89705f4136b4a597, 0x31680a88f8953031}, // 5^-9
+  {0xabcc77118461cefc, 0xfdc20d2b36ba7c3e}, // 5^-8
+  {0xd6bf94d5e57a42bc, 0x3d32907604691b4d}, // 5^-7
+  {0x8637bd05af6c69b5, 0xa63f9a49c2c1b110}, // 5^-6
+  {0xa7c5ac471b478423, 0x0fcf80dc33721d54}, // 5^-5
+  {0xd1b71758e219652b, 0xd3c36113404ea4a9}, // 5^-4
+  {0x83126e978d4fdf3b, 0x645a1cac083126ea}, // 5^-3
+  {0xa3d70a3d70a3d70a, 0x3d70a3d70a3d70a4}, // 5^-2
+  {0xcccccccccccccccc, 0xcccccccccccccccd}, // 5^-1
+  {0x8000000000000000, 0x0000000000000000}, // 5^0
+  {0xa000000000000000, 0x0000000000000000}, // 5^1
+  {0xc800000000000000, 0x0000000000000000}, // 5^2
+  {0xfa00000000000000, 0x0000000000000000}, // 5^3
+  {0x9c40000000000000, 0x0000000000000000}, // 5^4
+  {0xc350000000000000, 0x0000000000000000}, // 5^5
+  {0xf424000000000000, 0x0000000000000000}, // 5^6
+  {0x9896800000000000, 0x0000000000000000}, // 5^7
+  {0xbebc200000000000, 0x0000000000000000}, // 5^8
+  {0xee6b280000000000, 0x0000000000000000}, // 5^9
+  {0x9502f90000000000, 0x0000000000000000}, // 5^10
+  {0xba43b74000000000, 0x0000000000000000}, // 5^11
+  {0xe8d4a51000000000, 0x0000000000000000}, // 5^12
+  {0x9184e72a00000000, 0x0000000000000000}, // 5^13
+  {0xb5e620f480000000, 0x0000000000000000}, // 5^14
+  {0xe35fa931a0000000, 0x0000000000000000}, // 5^15
+  {0x8e1bc9bf04000000, 0x0000000000000000}, // 5^16
+  {0xb1a2bc2ec5000000, 0x0000000000000000}, // 5^17
+  {0xde0b6b3a76400000, 0x0000000000000000}, // 5^18
+  {0x8ac7230489e80000, 0x0000000000000000}, // 5^19
+  {0xad78ebc5ac620000, 0x0000000000000000}, // 5^20
+  {0xd8d726b7177a8000, 0x0000000000000000}, // 5^21
+  {0x878678326eac9000, 0x0000000000000000}, // 5^22
+  {0xa968163f0a57b400, 0x0000000000000000}, // 5^23
+  {0xd3c21bcecceda100, 0x0000000000000000}, // 5^24
+  {0x84595161401484a0, 0x0000000000000000}, // 5^25
+  {0xa56fa5b99019a5c8, 0x0000000000000000}, // 5^26
+  {0xcecb8f27f4200f3a, 0x0000000000000000}, // 5^27
+  {0x813f3978f8940984, 0x4000000000000000}, // 5^28
+  {0xa18f07d736b90be5, 0x5000000000000000}, // 5^29
+  {0xc9f2c9cd04674ede, 0xa400000000000000}, // 5^30
+  {0xfc6f7c4045812296, 0x4d00000000000000}, // 5^31
+  {0x9dc5ada82b70b59d, 0xf020000000000000}, // 5^32
+  {0xc5371912364ce305, 0x6c28000000000000}, // 5^33
+  {0xf684df56c3e01bc6, 0xc732000000000000}, // 5^34
+  {0x9a130b963a6c115c, 0x3c7f400000000000}, // 5^35
+  {0xc097ce7bc90715b3, 0x4b9f100000000000}, // 5^36
+  {0xf0bdc21abb48db20, 0x1e86d40000000000}, // 5^37
+  {0x96769950b50d88f4, 0x1314448000000000}, // 5^38
+  {0xbc143fa4e250eb31, 0x17d955a000000000}, // 5^39
+  {0xeb194f8e1ae525fd, 0x5dcfab0800000000}, // 5^40
+  {0x92efd1b8d0cf37be, 0x5aa1cae500000000}, // 5^41
+  {0xb7abc627050305ad, 0xf14a3d9e40000000}, // 5^42
+  {0xe596b7b0c643c719, 0x6d9ccd05d0000000}, // 5^43
+  {0x8f7e32ce7bea5c6f, 0xe4820023a2000000}, // 5^44
+  {0xb35dbf821ae4f38b, 0xdda2802c8a800000}, // 5^45
+  {0xe0352f62a19e306e, 0xd50b2037ad200000}, // 5^46
+  {0x8c213d9da502de45, 0x4526f422cc340000}, // 5^47
+  {0xaf298d050e4395d6, 0x9670b12b7f410000}, // 5^48
+  {0xdaf3f04651d47b4c, 0x3c0cdd765f114000}, // 5^49
+  {0x88d8762bf324cd0f, 0xa5880a69fb6ac800}, // 5^50
+  {0xab0e93b6efee0053, 0x8eea0d047a457a00}, // 5^51
+  {0xd5d238a4abe98068, 0x72a4904598d6d880}, // 5^52
+  {0x85a36366eb71f041, 0x47a6da2b7f864750}, // 5^53
+  {0xa70c3c40a64e6c51, 0x999090b65f67d924}, // 5^54
+  {0xd0cf4b50cfe20765, 0xfff4b4e3f741cf6d}, // 5^55
+  {0x82818f1281ed449f, 0xbff8f10e7a8921a4}, // 5^56
+  {0xa321f2d7226895c7, 0xaff72d52192b6a0d}, // 5^57
+  {0xcbea6f8ceb02bb39, 0x9bf4f8a69f764490}, // 5^58
+  {0xfee50b7025c36a08, 0x02f236d04753d5b4}, // 5^59
+  {0x9f4f2726179a2245, 0x01d762422c946590}, // 5^60
+  {0xc722f0ef9d80aad6, 0x424d3ad2b7b97ef5}, // 5^61
+  {0xf8ebad2b84e0d58b, 0xd2e0898765a7deb2}, // 5^62
+  {0x9b934c3b330c8577, 0x63cc55f49f88eb2f}, // 5^63
+  {0xc2781f49ffcfa6d5, 0x3cbf6b71c76b25fb}, // 5^64
+};
+
+// Powers of ten that are exactly representable as a double
+inline constexpr double EXACT_POWERS_OF_TEN[] = {
+  1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+  1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22,
+};
+
+struct Product
+{
+  std::uint64_t high;
+  std::uint64_t low;
+};
+
+inline Product multiply(std::uint64_t a, std::uint64_t b)
+{
+#if defined(__SIZEOF_INT128__)
+  unsigned __int128 r = static_cast<unsigned __int128>(a) * b;
+  return {static_cast<std::uint64_t>(r >> 64), static_cast<std::uint64_t>(r)};
+#else
+  std::uint64_t aLow = a & 0xffffffff, aHigh = a >> 32;
+  std::uint64_t bLow = b & 0xffffffff, bHigh = b >> 32;
+  std::uint64_t ll = aLow * bLow, lh = aLow * bHigh, hl = aHigh * bLow, hh = aHigh * bHigh;
+  std::uint64_t middle = (ll >> 32) + (lh & 0xffffffff) + (hl & 0xffffffff);
+  return {hh + (lh >> 32) + (hl >> 32) + (middle >> 32), (middle << 32) | (ll & 0xffffffff)};
+#endif
+}
+
+inline int leading_zeroes(std::uint64_t x)
+{
+#if defined(__GNUC__) || defined(__clang__)
+  return __builtin_clzll(x);
+#else
+  int n = 0;
+  while (!(x & (std::uint64_t(1) << 63))) {
+    x <<= 1;
+    ++n;
+  }
+  return n;
+#endif
+}
+
+// Eisel-Lemire: rounds w * 10^q to the nearest double using one or two 64 bit
+// multiplications. Returns false for subnormals, overflow and the rare
+// products it cannot round with certainty
+inline bool eisel_lemire(std::uint64_t w, std::int64_t q, double &value)
+{
+  int lz = leading_zeroes(w);
+  w <<= lz;
+
+  const std::uint64_t *power = POWERS_OF_FIVE[q - POWER_OF_FIVE_MIN];
+  Product product = multiply(w, power[0]);
+  if ((product.high & 0x1ff) == 0x1ff) {
+    Product second = multiply(w, power[1]);
+    product.low += second.high;
+    if (second.high > product.low) {
+      ++product.high;
+    }
+  }
+  if (product.low == UINT64_MAX && (q < -27 || q > 55)) {
+    return false;
+  }
+
+  int upperbit = static_cast<int>(product.high >> 63);
+  std::uint64_t mantissa = product.high >> (upperbit + 9);
+  std::int64_t power2 = ((217706 * q) >> 16) + 63 + upperbit - lz + 1023;
+  if (power2 <= 0) {
+    return false;
+  }
+
+  // Exactly halfway between two doubles: round to even
+  if (product.low <= 1 && q >= -4 && q <= 23 && (mantissa & 3) == 1 &&
+      (mantissa << (upperbit + 9)) == product.high) {
+    mantissa &= ~std::uint64_t(1);
+  }
+  mantissa += mantissa & 1;
+  mantissa >>= 1;
+  if (mantissa >= (std::uint64_t(2) << 52)) {
+    mantissa = std::uint64_t(1) << 52;
+    ++power2;
+  }
+  if (power2 >= 0x7ff) {
+    return false;
+  }
+
+  std::uint64_t bits = (mantissa & ~(std::uint64_t(1) << 52)) | static_cast<std::uint64_t>(power2) << 52;
+  std::memcpy(&value, &bits, sizeof(value));
+  return true;
+}
+
+// Correctly rounded and independent of the locale. Numbers with at most 19
+// significant digits are converted exactly (Clinger) when both the
+// significand and the power of ten are representable, otherwise with
+// Eisel-Lemire; anything else is left to the standard library
+inline void parse_number(std::string_view text, double &value)
+{
+  const char *p = text.data();
+  const char *end = p + text.size();
+  auto digit = [&]() { return p != end && static_cast<unsigned char>(*p - '0') < 10; };
+
+  bool negative = p != end && *p == '-';
+  if (negative) {
+    ++p;
+  }
+  if (!digit()) {
+    throw decode_error("json: expected number");
+  }
+
+  const char *digits = p;
+  std::uint64_t w = 0;
+  if (*p == '0') {
+    ++p;
+  } else {
+    while (digit()) {
+      w = w * 10 + static_cast<unsigned>(*p++ - '0');
+    }
+  }
+  std::int64_t q = 0;
+  if (p != end && *p == '.') {
+    const char *fraction = ++p;
+    while (digit()) {
+      w = w * 10 + static_cast<unsigned>(*p++ - '0');
+    }
+    if (p == fraction) {
+      throw decode_error("json: expected number");
+    }
+    q = fraction - p;
+  }
+
+  // Leading zeroes do not count towards the 19 digits that fit in w
+  const char *significant = digits;
+  while (significant != p && (*significant == '0' || *significant == '.')) {
+    ++significant;
+  }
+  std::ptrdiff_t count = p - significant;
+  if (std::memchr(significant, '.', count)) {
+    --count;
+  }
+
+  if (p != end && (*p == 'e' || *p == 'E')) {
+    ++p;
+    bool negativeExponent = p != end && *p == '-';
+    if (p != end && (*p == '-' || *p == '+')) {
+      ++p;
+    }
+    if (!digit()) {
+      throw decode_error("json: expected number");
+    }
+    std::int64_t exponent = 0;
+    while (digit()) {
+      if (exponent < 0x10000000) {
+        exponent = exponent * 10 + (*p - '0');
+      }
+      ++p;
+    }
+    q += negativeExponent ? -exponent : exponent;
+  }
+  if (p != end) {
+    throw decode_error("json: expected number");
+  }
+
+  if (w == 0) {
+    value = negative ? -0.0 : 0.0;
+    return;
+  }
+  if (count <= 19) {
+    if (q >= -22 && q <= 22 && w <= (std::uint64_t(1) << 53)) {
+      value = static_cast<double>(w);
+      value = q < 0 ? value / EXACT_POWERS_OF_TEN[-q] : value * EXACT_POWERS_OF_TEN[q];
+      value = negative ? -value : value;
+      return;
+    }
+    if (q >= POWER_OF_FIVE_MIN && q <= POWER_OF_FIVE_MAX && eisel_lemire(w, q, value)) {
+      value = negative ? -value : value;
+      return;
+    }
+  }
+
+#if defined(__cpp_lib_to_chars)
+  auto result = std::from_chars(text.data(), end, value);
+  if (result.ec == std::errc::result_out_of_range) {
+    if (q > 0) {
+      throw decode_error("json: number out of range");
+    }
+    value = negative ? -0.0 : 0.0;
+  }
+#else
+  // strtod honours the locale's decimal point, the text is JSON grammar
+  // checked above so only the separator needs translating
+  std::string buffer(text);
+  const char *point = std::localeconv()->decimal_point;
+  std::size_t dot = buffer.find('.');
+  if (dot != std::string::npos) {
+    buffer.replace(dot, 1, point);
+  }
+  value = std::strtod(buffer.c_str(), nullptr);
+#endif
+}
+
+// Writes the shortest text that reads back as the same double. JSON has no
+// representation of NaN and infinities, which are rejected
+inline void write_number(std::string &out, double value)
+{
+  if (!std::isfinite(value)) {
+    throw encode_error("json: number is not finite");
+  }
+  char buffer[32];
+#if defined(__cpp_lib_to_chars)
+  auto result = std::to_chars(buffer, buffer + sizeof(buffer), value);
+  out.append(buffer, result.ptr);
+#else
+  int n = std::snprintf(buffer, sizeof(buffer), "%.17g", value);
+  out.append(buffer, n);
+#endif
+}
+
+}
+}
@@ -0,0 +1,93 @@
+// Checks of the integer types narrowed from tests/bounds.schema.json and of
+// the range checks its codecs make. make test generates the codecs into
+// tests/out before building this
+
+#include "bounds.json.h"
+#include "bounds.msgpack.h"
+
+#include <cstdio>
+#include <string>
+#include <type_traits>
+
+static int failures = 0;
+
+static void check(bool passed, const std::string &what)
+{
+  if (!passed) {
+    std::fprintf(stderr, "FAILED: %s\n", what.c_str());
+    ++failures;
+  }
+}
+
+template <typename Member, typename Expected>
+static void member_type(const char *name)
+{
+  check(std::is_same<Member, Expected>::value, std::string("type of ") + name);
+}
+
+static void narrowed_types()
+{
+  member_type<decltype(Base::small), std::uint8_t>("small, 0 to 100 and required");
+  member_type<decltype(Base::byte), std::optional<std::uint8_t>>("byte, 0 to 255");
+  member_type<decltype(Base::level), std::optional<std::uint16_t>>("level, 1 to 9999");
+  member_type<decltype(Base::total), std::optional<std::uint32_t>>("total, 0 to 4000000000");
+  member_type<decltype(Base::tiny), std::optional<std::int8_t>>("tiny, -128 to 127");
+  member_type<decltype(Base::mid), std::optional<std::int16_t>>("mid, -5 to 200");
+  member_type<decltype(Base::frac), std::optional<std::uint16_t>>("frac, 0.5 to 65535.9");
+  member_type<decltype(Base::count), std::optional<std::uint64_t>>("count, only a minimum of 1");
+  member_type<decltype(Base::big), std::optional<std::int64_t>>("big, unbounded");
+  member_type<decltype(Base::huge), std::optional<std::uint64_t>>("huge, minimum 0 and a default above INT64_MAX");
+  member_type<decltype(Base::unbounded), std::optional<std::uint64_t>>("unbounded, a default above INT64_MAX");
+  member_type<decltype(Base::levels), std::vector<std::uint8_t>>("levels, items 1 to 10");
+}
+
+static bool json_rejects(const std::string &text)
+{
+  Base value;
+  try {
+    jschema::json::decode(text, value);
+  } catch (const jschema::json::decode_error &) {
+    return true;
+  }
+  return false;
+}
+
+static bool msgpack_rejects(const Base &value)
+{
+  std::vector<std::uint8_t> data = jschema::msgpack::encode(value);
+  Base decoded;
+  try {
+    jschema::msgpack::decode(data.data(), data.size(), decoded);
+  } catch (const jschema::msgpack::decode_error &) {
+    return true;
+  }
+  return false;
+}
+
+static void range_checks()
+{
+  check(!json_rejects(R"({"small": 100, "level": 9999, "total": 4000000000, "mid": -5, "levels": [1, 10]})"),
+        "values at their bounds are accepted");
+  check(json_rejects(R"({"small": 101})"), "small above its maximum is rejected");
+  check(json_rejects(R"({"small": 5, "level": 0})"), "level below its minimum is rejected");
+  check(json_rejects(R"({"small": 5, "level": 10000})"), "level above its maximum is rejected");
+  check(json_rejects(R"({"small": 5, "total": 4000000001})"), "total above its maximum is rejected");
+  check(json_rejects(R"({"small": 5, "byte": 256})"), "byte beyond its type is rejected");
+  check(json_rejects(R"({"small": 5, "mid": -6})"), "mid below its minimum is rejected");
+  check(json_rejects(R"({"small": 5, "levels": [1, 11]})"), "an item above its maximum is rejected");
+  check(json_rejects(R"({"small": 5, "ratio": 1.5})"), "ratio above its maximum is rejected");
+
+  // The encoders write whatever the struct holds, so out of range values reach the decoder
+  Base value;
+  value.level = 10000;
+  check(msgpack_rejects(value), "msgpack: level above its maximum is rejected");
+  value.level = 9999;
+  check(!msgpack_rejects(value), "msgpack: level at its maximum is accepted");
+}
+
+int main()
+{
+  narrowed_types();
+  range_checks();
+  return failures ? 1 : 0;
+}
@@ -0,0 +1,118 @@
+// Round trips of tests/codecs.schema.json through every codec. make test
+// generates the codecs into tests/out before building this
+
+#include "codecs.cbor.h"
+#include "codecs.flat.h"
+#include "codecs.json.h"
+#include "codecs.msgpack.h"
+
+#include <cstdio>
+#include <string>
+
+static int failures = 0;
+
+static void check(bool passed, const std::string &what)
+{
+  if (!passed) {
+    std::fprintf(stderr, "FAILED: %s\n", what.c_str());
+    ++failures;
+  }
+}
+
+static bool same(const Owner &a, const Owner &b)
+{
+  return a.age == b.age && a.name == b.name;
+}
+
+static bool same(const Base &a, const Base &b)
+{
+  return a.enabled == b.enabled && a.flags == b.flags && a.id == b.id && a.kind == b.kind && a.level == b.level &&
+         a.name == b.name && a.offset == b.offset && a.owner.has_value() == b.owner.has_value() &&
+         (!a.owner || same(*a.owner, *b.owner)) && a.ratio == b.ratio && a.scores == b.scores && a.tags == b.tags &&
+         a.total == b.total;
+}
+
+// Every member set, with values at the edges of their types
+static Base full()
+{
+  Base base;
+  base.enabled = false;
+  base.flags = {true, false, false, true, true};
+  base.id = boost::uuids::uuid {{0x12, 0x34, 0x56, 0x78, 0x9a, 0xbc, 0xde, 0xf0, 0x0f, 0xed, 0xcb, 0xa9, 0x87, 0x65, 0x43, 0x21}};
+  base.kind = large;
+  base.level = 9999;
+  base.name = "quote \" backslash \\ newline \n unicode \xc3\xa9";
+  base.offset = -9007199254740993;
+  base.owner = Owner {42, "owner"};
+  base.ratio = 0.1;
+  base.scores = {-1.5, 0.0, 1e300, 5e-324};
+  base.tags = {"", "a", std::string(300, 'x')};
+  base.total = 4000000000;
+  return base;
+}
+
+// Only the required members set
+static Base minimal()
+{
+  Base base;
+  base.level = 1;
+  base.name = "minimal";
+  return base;
+}
+
+template <typename Encode, typename Decode>
+static void round_trip(const char *codec, const Base &value, Encode encode, Decode decode)
+{
+  Base decoded;
+  try {
+    decode(encode(value), decoded);
+    check(same(value, decoded), std::string(codec) + ": " + value.name + " reads back unchanged");
+  } catch (const std::exception &e) {
+    check(false, std::string(codec) + ": " + value.name + " threw " + e.what());
+  }
+}
+
+static void flat_view(const Base &value)
+{
+  std::vector<std::uint8_t> data = jschema::flat::build<jschema::flat::Base>(value);
+  jschema::flat::Base view = jschema::flat::root<jschema::flat::Base>(data.data(), data.size());
+
+  std::vector<bool> flags(view.flags().begin(), view.flags().end());
+  std::vector<double> scores(view.scores().begin(), view.scores().end());
+  std::vector<std::string> tags;
+  for (std::string_view tag : view.tags()) {
+    tags.emplace_back(tag);
+  }
+
+  check(view.has_enabled() == value.enabled.has_value() && (!value.enabled || view.enabled() == *value.enabled),
+        "flat: enabled");
+  check(flags == value.flags, "flat: flags");
+  check(view.has_id() == value.id.has_value() && (!value.id || view.id() == *value.id), "flat: id");
+  check(view.has_kind() == value.kind.has_value() && (!value.kind || view.kind() == *value.kind), "flat: kind");
+  check(view.level() == value.level, "flat: level");
+  check(view.name() == value.name, "flat: name");
+  check(view.has_offset() == value.offset.has_value() && (!value.offset || view.offset() == *value.offset),
+        "flat: offset");
+  check(view.has_owner() == value.owner.has_value() &&
+        (!value.owner || (view.owner().name() == value.owner->name && view.owner().has_age() &&
+                          view.owner().age() == *value.owner->age)),
+        "flat: owner");
+  check(view.has_ratio() == value.ratio.has_value() && (!value.ratio || view.ratio() == *value.ratio), "flat: ratio");
+  check(scores == value.scores, "flat: scores");
+  check(tags == value.tags, "flat: tags");
+  check(view.has_total() == value.total.has_value() && (!value.total || view.total() == *value.total), "flat: total");
+}
+
+int main()
+{
+  for (const Base &value : {full(), minimal()}) {
+    round_trip("msgpack", value, [](const Base &v) { return jschema::msgpack::encode(v); },
+               [](const std::vector<std::uint8_t> &data, Base &v) { jschema::msgpack::decode(data.data(), data.size(), v); });
+    round_trip("cbor", value, [](const Base &v) { return jschema::cbor::encode(v); },
+               [](const std::vector<std::uint8_t> &data, Base &v) { jschema::cbor::decode(data.data(), data.size(), v); });
+    round_trip("json", value, [](const Base &v) { return jschema::json::encode(v); },
+               [](const std::string &text, Base &v) { jschema::json::decode(text, v); });
+    flat_view(value);
+  }
+  return failures ? 1 : 0;
+}
@@ -0,0 +1,47 @@
+#pragma once
+
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <vector>
+#include <boost/uuid/uuid.hpp>
+
+enum Kind
+{
+  a,
+  b,
+};
+
+
+struct Home
+{
+  std::optional<std::uint16_t> number;
+  std::string street;
+};
+
+struct Price
+{
+  std::optional<double> amount;
+  std::optional<std::string> currency;
+};
+
+struct HomeSite
+{
+  std::optional<Home> at;
+};
+
+struct Base
+{
+  std::optional<Price> cost;
+  std::optional<Home> home;
+  std::optional<HomeSite> homeSite;
+  std::optional<Kind> kind;
+  std::optional<Price> price;
+  std::optional<Home> work;
+  std::optional<HomeSite> workSite;
+};
+
+using At = Home;
+using Cost = Price;
+using Work = Home;
+using WorkSite = HomeSite;
@@ -0,0 +1,25 @@
+module;
+
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <vector>
+#include <boost/uuid/uuid.hpp>
+
+export module shapes:Base;
+
+import :Home;
+import :HomeSite;
+import :Kind;
+import :Price;
+
+export struct Base
+{
+  std::optional<Price> cost;
+  std::optional<Home> home;
+  std::optional<HomeSite> homeSite;
+  std::optional<Kind> kind;
+  std::optional<Price> price;
+  std::optional<Home> work;
+  std::optional<HomeSite> workSite;
+};
@@ -0,0 +1,16 @@
+module;
+
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <vector>
+#include <boost/uuid/uuid.hpp>
+
+export module shapes:Home;
+
+
+export struct Home
+{
+  std::optional<std::uint16_t> number;
+  std::string street;
+};
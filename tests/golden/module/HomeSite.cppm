@@ -0,0 +1,16 @@
+module;
+
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <vector>
+#include <boost/uuid/uuid.hpp>
+
+export module shapes:HomeSite;
+
+import :Home;
+
+export struct HomeSite
+{
+  std::optional<Home> at;
+};
@@ -0,0 +1,7 @@
+export module shapes:Kind;
+
+export enum Kind
+{
+  a,
+  b,
+};
@@ -0,0 +1,16 @@
+module;
+
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <vector>
+#include <boost/uuid/uuid.hpp>
+
+export module shapes:Price;
+
+
+export struct Price
+{
+  std::optional<double> amount;
+  std::optional<std::string> currency;
+};
@@ -0,0 +1,11 @@
+export module shapes;
+
+export import :Kind;
+export import :Home;
+export import :Price;
+export import :HomeSite;
+export import :Base;
+export using At = Home;
+export using Cost = Price;
+export using Work = Home;
+export using WorkSite = HomeSite;
@@ -0,0 +1,24 @@
+#pragma once
+
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <vector>
+#include <boost/uuid/uuid.hpp>
+
+#include "shapes.fwd.h"
+#include "Home.h"
+#include "HomeSite.h"
+#include "Kind.h"
+#include "Price.h"
+
+struct Base
+{
+  std::optional<Price> cost;
+  std::optional<Home> home;
+  std::optional<HomeSite> homeSite;
+  std::optional<Kind> kind;
+  std::optional<Price> price;
+  std::optional<Home> work;
+  std::optional<HomeSite> workSite;
+};
@@ -0,0 +1,15 @@
+#pragma once
+
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <vector>
+#include <boost/uuid/uuid.hpp>
+
+#include "shapes.fwd.h"
+
+struct Home
+{
+  std::optional<std::uint16_t> number;
+  std::string street;
+};
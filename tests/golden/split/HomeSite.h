@@ -0,0 +1,15 @@
+#pragma once
+
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <vector>
+#include <boost/uuid/uuid.hpp>
+
+#include "shapes.fwd.h"
+#include "Home.h"
+
+struct HomeSite
+{
+  std::optional<Home> at;
+};
@@ -0,0 +1,7 @@
+#pragma once
+
+enum Kind
+{
+  a,
+  b,
+};
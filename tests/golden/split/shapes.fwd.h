@@ -0,0 +1,10 @@
+#pragma once
+
+struct Home;
+struct Price;
+struct HomeSite;
+struct Base;
+using At = Home;
+using Cost = Price;
+using Work = Home;
+using WorkSite = HomeSite;
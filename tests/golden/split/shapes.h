@@ -0,0 +1,8 @@
+#pragma once
+
+#include "shapes.fwd.h"
+#include "Kind.h"
+#include "Home.h"
+#include "Price.h"
+#include "HomeSite.h"
+#include "Base.h"
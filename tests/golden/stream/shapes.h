@@ -0,0 +1,46 @@
+#pragma once
+
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <vector>
+#include <boost/uuid/uuid.hpp>
+
+struct Home
+{
+  std::optional<std::uint16_t> number;
+  std::string street;
+};
+
+using Work = Home;
+struct Price
+{
+  std::optional<double> amount;
+  std::optional<std::string> currency;
+};
+
+using Cost = Price;
+using At = Home;
+struct HomeSite
+{
+  std::optional<Home> at;
+};
+
+using WorkSite = HomeSite;
+enum Kind
+{
+  a,
+  b,
+};
+
+struct Base
+{
+  std::optional<Price> cost;
+  std::optional<Home> home;
+  std::optional<HomeSite> homeSite;
+  std::optional<Kind> kind;
+  std::optional<Price> price;
+  std::optional<Home> work;
+  std::optional<HomeSite> workSite;
+};
+
@@ -0,0 +1,128 @@
+// Checks of the template renderer that the generator is built on, both
+// walking the parsed templates and running them as bytecode. Run with
+// make test, which fails when any check does
+
+#include <inja/inja.hpp>
+
+#include <cstdio>
+#include <sstream>
+#include <streambuf>
+#include <string>
+
+static int failures = 0;
+
+static void check(inja::Environment &env, const std::string &source, const std::string &expected)
+{
+  inja::json data;
+  std::string result;
+  try {
+    result = env.render(source, data);
+  } catch (const std::exception &e) {
+    result = e.what();
+  }
+  if (result != expected) {
+    std::fprintf(stderr, "FAILED: %s\n  expected %s\n  rendered %s\n", source.c_str(), expected.c_str(), result.c_str());
+    ++failures;
+  }
+}
+
+static void check_throws(inja::Environment &env, const std::string &source, const std::string &message)
+{
+  inja::json data;
+  std::string error;
+  try {
+    env.render(source, data);
+  } catch (const std::exception &e) {
+    error = e.what();
+  }
+  if (error.find(message) == std::string::npos) {
+    std::fprintf(stderr, "FAILED: %s\n  expected an error with %s\n  got %s\n", source.c_str(), message.c_str(), error.c_str());
+    ++failures;
+  }
+}
+
+// A set in the body replaces the container that is being iterated
+static void set_iterated_container(inja::Environment &env)
+{
+  check(env, "{% set xs = [1,2,3] %}{% for x in xs %}{% set xs = 0 %}{{ x }}{% endfor %}", "123");
+  check(env, "{% set a = {\"xs\": [1,2]} %}{% for x in a.xs %}{% set a = 0 %}{{ x }}{% endfor %}", "12");
+  check(env, "{% set m = [[1,2],[3]] %}{% for x in first(m) %}{% set m = 0 %}{{ x }}{% endfor %}", "12");
+}
+
+// An included template sets a variable of its own while the including one iterates a set variable
+static void include_with_local_data(inja::Environment &env)
+{
+  env.include_template("inc", env.parse("{% set y = 1 %}[{{ y }}]"));
+  check(env, "{% set xs = [1,2,3] %}{% for x in xs %}{% include \"inc\" %}{{ x }}{% endfor %}", "[1]1[1]2[1]3");
+  check(env, "{% set y = 0 %}{% include \"inc\" %}{{ y }}", "[1]0");
+}
+
+// Loop variables are not looked up among the set variables, so setting one is an error
+static void set_loop_variable(inja::Environment &env)
+{
+  check_throws(env, "{% for x in [1,2,3] %}{% set x = 9 %}{{ x }},{% endfor %}", "cannot set loop variable 'x'");
+  check_throws(env, "{% for k, v in {\"a\": 1} %}{% set k.b = 9 %}{% endfor %}", "cannot set loop variable 'k'");
+  env.include_template("set_x", env.parse("{% set x = 9 %}{{ x }}"));
+  check_throws(env, "{% for x in [1,2,3] %}{% include \"set_x\" %}{% endfor %}", "cannot set loop variable 'x'");
+  check(env, "{% for x in [1,2] %}{{ x }}{% endfor %}{% set x = 9 %}{{ x }}", "129");
+}
+
+// Keeps what is written to it, without the positions that tellp() needs, like a pipe
+class UnseekableBuffer : public std::streambuf {
+public:
+  std::string written;
+
+protected:
+  int_type overflow(int_type c) override {
+    if (!traits_type::eq_int_type(c, traits_type::eof())) {
+      written += traits_type::to_char_type(c);
+    }
+    return traits_type::not_eof(c);
+  }
+};
+
+// The profiler counts the output of every node on streams that cannot tell their position
+static void profile_unseekable_output()
+{
+  inja::Environment env;
+  inja::RenderProfiler profiler;
+  env.set_profiler(&profiler);
+
+  UnseekableBuffer buffer;
+  std::ostream os(&buffer);
+  env.render_to(os, env.parse("{% for x in [1,2,3] %}ab{{ x }}{% endfor %}!"), inja::json::object());
+
+  std::ostringstream report;
+  profiler.write_report(report);
+  std::istringstream lines(report.str());
+  std::string line;
+  std::string for_bytes;
+  while (std::getline(lines, line)) {
+    if (line.size() > 4 && line.compare(line.size() - 4, 4, " for") == 0) {
+      std::istringstream columns(line);
+      std::string column;
+      for (int i = 0; i < 5; ++i) {
+        columns >> column;
+      }
+      for_bytes = column;
+    }
+  }
+  if (buffer.written != "ab1ab2ab3!" || for_bytes != "9") {
+    std::fprintf(stderr, "FAILED: profile of unseekable output\n  rendered %s\n%s", buffer.written.c_str(),
+                 report.str().c_str());
+    ++failures;
+  }
+}
+
+int main()
+{
+  for (bool bytecode : {false, true}) {
+    inja::Environment env;
+    env.set_compile_bytecode(bytecode);
+    set_iterated_container(env);
+    include_with_local_data(env);
+    set_loop_variable(env);
+  }
+  profile_unseekable_output();
+  return failures ? 1 : 0;
+}
@@ -0,0 +1,60 @@
+// Checks of the runtime that the generated JSON codec is built on. Run with
+// make test, which fails when any check does
+
+#include "../templates/jschema_runtime.h"
+
+#include <cstdio>
+#include <limits>
+
+using namespace jschema;
+
+static int failures = 0;
+
+static void check(bool passed, const char *what)
+{
+  if (!passed) {
+    std::fprintf(stderr, "FAILED: %s\n", what);
+    ++failures;
+  }
+}
+
+static void numbers_round_trip()
+{
+  const double values[] = {
+    0.0, -0.0, 1.0, -1.5, 0.1, 1e-300, 5e-324, 1.7976931348623157e308, 123456789.123456789,
+    static_cast<double>(std::numeric_limits<std::int64_t>::max()),
+  };
+  for (double value : values) {
+    std::string text;
+    runtime::write_number(text, value);
+    double read = 1.0;
+    runtime::parse_number(text, read);
+    check(read == value && std::signbit(read) == std::signbit(value), text.c_str());
+  }
+}
+
+static void non_finite_numbers_are_rejected()
+{
+  const double values[] = {
+    std::numeric_limits<double>::quiet_NaN(),
+    std::numeric_limits<double>::infinity(),
+    -std::numeric_limits<double>::infinity(),
+  };
+  for (double value : values) {
+    std::string text;
+    bool thrown = false;
+    try {
+      runtime::write_number(text, value);
+    } catch (const runtime::encode_error &) {
+      thrown = true;
+    }
+    check(thrown && text.empty(), "non-finite number is rejected");
+  }
+}
+
+int main()
+{
+  numbers_round_trip();
+  non_finite_numbers_are_rejected();
+  return failures ? 1 : 0;
+}